@@ -1,3 +1,4 @@
+using System.Collections.Generic;
 using UnityEngine;
 using UnityEngine.XR.ARFoundation;
 using UnityEngine.XR.ARSubsystems;
@@ -8,6 +9,7 @@ namespace IndoorAtlas {
 [AddComponentMenu("IndoorAtlas/IndoorAtlas AR Wayfinding")]
 public class IndoorAtlasARWayfinding : MonoBehaviour {
     LocationManager manager = null;
+    IndoorAtlasSession session = null;
 
     [Header("IndoorAtlas AR wayfinding configuration")]
 
@@ -24,7 +26,7 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
         set {
             m_target = value;
             if (manager != null && m_wayfinding) {
-                InstantiateTurns();
+                HideTurns();
                 manager.StopMonitoringForWayfinding();
                 manager.StartMonitoringForWayfinding(m_target);
             }
@@ -40,7 +42,7 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
         get { return m_wayfinding; }
         set {
             if (m_wayfinding == value) return;
-            if (manager != null) InstantiateTurns();
+            if (manager != null) HideTurns();
             if ((m_wayfinding = value)) {
                 if (manager != null) {
                     manager.StartMonitoringForWayfinding(m_target);
@@ -58,14 +60,55 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
     ARPlaneManager m_planeManager;
 
     /// <summary>
-    /// The <c>LatLngFloor</c> that marks the target for navigation.
+    /// The <c>ARPlaneManager</c> for capturing horizontal planes.
     /// </summary>
     public ARPlaneManager planeManager
     {
         get { return m_planeManager; }
-        set { m_planeManager = value; }
+        set {
+            UnregisterPlaneEvents();
+            m_planeManager = value;
+            RegisterPlaneEvents();
+        }
+    }
+
+    [SerializeField]
+    [Tooltip("Planes are sent again only when their center or extents have changed more than this many meters.")]
+    float m_planeChangeThreshold = 0.1f;
+
+    /// <summary>
+    /// Planes are sent again only when their center or extents have changed more than this many meters.
+    /// </summary>
+    public float planeChangeThreshold
+    {
+        get { return m_planeChangeThreshold; }
+        set { m_planeChangeThreshold = value; }
+    }
+
+    [SerializeField]
+    [Tooltip("Minimum time in seconds between sending changed planes, 0 sends them on every AR frame.")]
+    float m_planeSubmitInterval = 0.0f;
+
+    /// <summary>
+    /// Minimum time in seconds between sending changed planes, 0 sends them on every AR frame.
+    /// </summary>
+    public float planeSubmitInterval
+    {
+        get { return m_planeSubmitInterval; }
+        set { m_planeSubmitInterval = value; }
     }
 
+    struct SubmittedPlane {
+        public Vector3 center;
+        public Vector2 extents;
+    }
+
+    // Planes added or changed since the last AR frame and the last sent state of every plane
+    readonly HashSet<ARPlane> pending_planes = new HashSet<ARPlane>();
+    readonly Dictionary<TrackableId, SubmittedPlane> submitted_planes = new Dictionary<TrackableId, SubmittedPlane>();
+    float[] plane_batch = new float[16 * LocationManager.ArPlaneStride];
+    float plane_submit_time = float.NegativeInfinity;
+
     [SerializeField]
     [Tooltip("The Camera to associate with the AR device.")]
     Camera m_camera;
@@ -94,13 +137,62 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
 
     void OnArFrame(ARCameraFrameEventArgs eventArgs) {
         if (manager == null || !IsTracking()) return;
-        foreach (ARPlane plane in m_planeManager.trackables) {
-            if (plane.alignment != PlaneAlignment.HorizontalUp) continue;
-            manager.AddArPlane(plane.center.x, plane.center.y, plane.center.z, plane.extents.x, plane.extents.y);
-        }
+        SubmitPendingPlanes();
         manager.SetArPoseMatrix(m_camera.transform.localToWorldMatrix);
     }
 
+    void QueuePlane(ARPlane plane) {
+        if (plane.alignment != PlaneAlignment.HorizontalUp) return;
+        SubmittedPlane submitted;
+        if (submitted_planes.TryGetValue(plane.trackableId, out submitted) &&
+            (plane.center - submitted.center).magnitude <= m_planeChangeThreshold &&
+            (plane.extents - submitted.extents).magnitude <= m_planeChangeThreshold) return;
+        pending_planes.Add(plane);
+    }
+
+    void OnPlanesChanged(ARPlanesChangedEventArgs eventArgs) {
+        foreach (ARPlane plane in eventArgs.added) QueuePlane(plane);
+        foreach (ARPlane plane in eventArgs.updated) QueuePlane(plane);
+        foreach (ARPlane plane in eventArgs.removed) {
+            pending_planes.Remove(plane);
+            submitted_planes.Remove(plane.trackableId);
+        }
+    }
+
+    void SubmitPendingPlanes() {
+        if (pending_planes.Count == 0 || Time.unscaledTime - plane_submit_time < m_planeSubmitInterval) return;
+        plane_submit_time = Time.unscaledTime;
+        int stride = LocationManager.ArPlaneStride;
+        if (plane_batch.Length < pending_planes.Count * stride) plane_batch = new float[pending_planes.Count * stride];
+        int count = 0;
+        foreach (ARPlane plane in pending_planes) {
+            if (!plane) continue; // destroyed without a removed event
+            int o = count++ * stride;
+            plane_batch[o] = plane.center.x;
+            plane_batch[o + 1] = plane.center.y;
+            plane_batch[o + 2] = plane.center.z;
+            plane_batch[o + 3] = plane.extents.x;
+            plane_batch[o + 4] = plane.extents.y;
+            submitted_planes[plane.trackableId] = new SubmittedPlane { center = plane.center, extents = plane.extents };
+        }
+        pending_planes.Clear();
+        manager.AddArPlanes(plane_batch, count);
+    }
+
+    void RegisterPlaneEvents() {
+        if (manager == null || !m_planeManager) return;
+        m_planeManager.planesChanged += OnPlanesChanged;
+        // planes detected before we subscribed never show up as added
+        foreach (ARPlane plane in m_planeManager.trackables) QueuePlane(plane);
+    }
+
+    void UnregisterPlaneEvents() {
+        if (manager == null || !m_planeManager) return;
+        m_planeManager.planesChanged -= OnPlanesChanged;
+        pending_planes.Clear();
+        submitted_planes.Clear();
+    }
+
     void RegisterFrameEvent() {
         if (manager == null) return;
         m_cameraManager.frameReceived += OnArFrame;
@@ -153,33 +245,91 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
     [SerializeField]
     [Tooltip("The GameObject that represents a navigation turn instruction.")]
     GameObject m_turn;
-    GameObject[] turns = null;
+    // Turn arrows are pooled for the lifetime of the component, the pool grows to the longest route seen
+    // and is never shrunk, so retargeting does not instantiate anything once warmed up. turns[0] is m_turn itself.
+    readonly List<GameObject> turns = new List<GameObject>();
+    readonly ArFrame frame = new ArFrame();
+
+    [SerializeField]
+    [Tooltip("POIs further than this many meters from the current location are not shown.")]
+    float m_poiRadius = 50.0f;
+
+    /// <summary>
+    /// POIs further than this many meters from the current location are not shown.
+    /// </summary>
+    public float poiRadius
+    {
+        get { return m_poiRadius; }
+        set { m_poiRadius = value; QueryVisiblePOIs(); }
+    }
+
+    [SerializeField]
+    [Tooltip("Maximum number of POI labels shown at once, nearest POIs are preferred.")]
+    int m_maxVisiblePois = 32;
+
+    /// <summary>
+    /// Maximum number of POI labels shown at once, nearest POIs are preferred.
+    /// </summary>
+    public int maxVisiblePois
+    {
+        get { return m_maxVisiblePois; }
+        set { m_maxVisiblePois = value; InstantiatePOIObjects(); }
+    }
 
-    POI[] pois = null;
+    [SerializeField]
+    [Tooltip("Hide POI labels that are outside of the camera view.")]
+    bool m_poiFrustumCulling = true;
+
+    /// <summary>
+    /// Hide POI labels that are outside of the camera view.
+    /// </summary>
+    public bool poiFrustumCulling
+    {
+        get { return m_poiFrustumCulling; }
+        set { m_poiFrustumCulling = value; }
+    }
+
+    POIIndex poi_index = null;
+    readonly List<int> poi_visible = new List<int>();
     GameObject[] poi_objects = null;
+    TextMesh[] poi_meshes = null;
+    GeoToArCache poi_anchors = null;
+
+    // Location of the latest fix and of the latest POI query
+    bool has_location = false;
+    double location_latitude, location_longitude;
+    int location_floor;
+    Vector2 poi_query_position;
+    int poi_query_floor;
 
     void SetObjectsActive(bool active) {
         if (m_compass) m_compass.SetActive(active);
         if (m_goal) m_goal.SetActive(active);
-        if (turns != null) foreach (GameObject turn in turns) turn.SetActive(active);
+        foreach (GameObject turn in turns) turn.SetActive(active);
         if (poi_objects != null) foreach (GameObject poi in poi_objects) poi.SetActive(active);
     }
 
     void DestroyTurns() {
-        if (turns != null) {
-            for (int i = 1; i < turns.Length; ++i) Destroy(turns[i]);
-            m_turn.SetActive(false);
-            turns = null;
-        }
+        for (int i = 1; i < turns.Count; ++i) Destroy(turns[i]);
+        if (turns.Count > 0 && turns[0]) turns[0].SetActive(false);
+        turns.Clear();
     }
 
-    void InstantiateTurns() {
-        DestroyTurns();
-        if (m_turn) {
+    void HideTurns() {
+        foreach (GameObject turn in turns) turn.SetActive(false);
+    }
+
+    // Grows the pool to at least count arrows, existing arrows are kept
+    void EnsureTurns(int count) {
+        if (!m_turn) return;
+        if (turns.Count == 0) {
             m_turn.SetActive(false);
-            turns = new GameObject[16]; // pool of 16 maximum turns (pretty optimistic)
-            turns[0] = m_turn;
-            for (int i = 1; i < turns.Length; ++i) turns[i] = Instantiate(m_turn);
+            turns.Add(m_turn);
+        }
+        while (turns.Count < count) {
+            GameObject turn = Instantiate(m_turn);
+            turn.SetActive(false);
+            turns.Add(turn);
         }
     }
 
@@ -187,22 +337,51 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
         if (poi_objects != null) {
             for (int i = 0; i < poi_objects.Length; ++i) Destroy(poi_objects[i]);
             poi_objects = null;
+            poi_meshes = null;
+            poi_anchors = null;
         }
     }
 
     void InstantiatePOIObjects() {
         DestroyPOIObjects();
-        if (pois != null) {
-            poi_objects = new GameObject[pois.Length];
-            for (int i = 0; i < pois.Length; ++i) {
-                var text = new GameObject(pois[i].id);
-                var mesh = text.AddComponent<TextMesh>();
-                text.transform.localScale = new Vector3(0.1f, 0.1f, 0.1f);
-                mesh.text = pois[i].name;
-                text.SetActive(false);
-                poi_objects[i] = text;
+        // pool of labels reused for whichever POIs are currently near, never more than m_maxVisiblePois
+        poi_objects = new GameObject[Mathf.Max(0, m_maxVisiblePois)];
+        poi_meshes = new TextMesh[poi_objects.Length];
+        poi_anchors = new GeoToArCache(poi_objects.Length, 0, 0.2f);
+        for (int i = 0; i < poi_objects.Length; ++i) {
+            var text = new GameObject("IndoorAtlas POI");
+            poi_meshes[i] = text.AddComponent<TextMesh>();
+            text.transform.localScale = new Vector3(0.1f, 0.1f, 0.1f);
+            text.SetActive(false);
+            poi_objects[i] = text;
+        }
+        QueryVisiblePOIs();
+    }
+
+    void QueryVisiblePOIs() {
+        if (poi_anchors == null) return;
+        if (poi_index == null || !has_location) {
+            poi_anchors.count = 0;
+        } else {
+            poi_index.Query(location_latitude, location_longitude, location_floor, m_poiRadius, poi_visible);
+            int count = Mathf.Min(poi_visible.Count, poi_anchors.capacity);
+            for (int i = 0; i < count; ++i) {
+                POI poi = poi_index.pois[poi_visible[i]];
+                poi_anchors.SetAnchor(i, poi.position.coordinate.latitude, poi.position.coordinate.longitude, poi.position.floor);
+                if (poi_meshes[i].text != poi.name) poi_meshes[i].text = poi.name;
+                poi_objects[i].name = poi.id;
             }
+            poi_anchors.count = count;
+            poi_query_position = poi_index.ToEN(location_latitude, location_longitude);
+            poi_query_floor = location_floor;
         }
+        for (int i = poi_anchors.count; i < poi_objects.Length; ++i) poi_objects[i].SetActive(false);
+    }
+
+    bool IsInView(Vector3 position) {
+        // small margin so that labels partially in view are not culled
+        Vector3 viewport = m_camera.WorldToViewportPoint(position);
+        return viewport.z > 0 && viewport.x > -0.2f && viewport.x < 1.2f && viewport.y > -0.2f && viewport.y < 1.2f;
     }
 
     /// <summary>
@@ -211,7 +390,13 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
     public GameObject turn
     {
         get { return m_turn; }
-        set { m_turn = value; InstantiateTurns(); }
+        set {
+            // Arrows of the previous prefab cannot be reused
+            int count = turns.Count;
+            DestroyTurns();
+            m_turn = value;
+            EnsureTurns(count);
+        }
     }
 
     void Awake() {
@@ -226,34 +411,61 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
            manager.StopMonitoringForWayfinding();
            manager.StartMonitoringForWayfinding(m_target);
         }
-        InstantiateTurns();
+        EnsureTurns(1);
         Application.onBeforeRender += OnBeforeRender;
         RegisterFrameEvent();
+        RegisterPlaneEvents();
+        session = GetComponentInParent<IndoorAtlasSession>();
+        if (session) {
+            session.locationDataChanged += OnLocationChanged;
+            session.enteredRegion += OnEnterRegion;
+            session.exitedRegion += OnExitRegion;
+            session.routeUpdated += OnRouteUpdated;
+        }
     }
 
     void OnDisable() {
         if (manager == null) return;
         m_cameraManager.frameReceived -= OnArFrame;
+        UnregisterPlaneEvents();
+        if (session) {
+            session.locationDataChanged -= OnLocationChanged;
+            session.enteredRegion -= OnEnterRegion;
+            session.exitedRegion -= OnExitRegion;
+            session.routeUpdated -= OnRouteUpdated;
+        }
+        session = null;
         Application.onBeforeRender -= OnBeforeRender;
         manager.StopMonitoringForWayfinding();
         manager.ReleaseArSession();
         manager = null;
-        DestroyTurns();
         SetObjectsActive(false);
     }
 
+    void OnDestroy() {
+        DestroyTurns();
+        DestroyPOIObjects();
+    }
+
     void OnBeforeRender() {
         if (manager == null) return;
 
         manager.SetArCameraToWorldMatrix(m_camera.cameraToWorldMatrix);
-        if (!m_wayfinding || !manager.GetArIsConverged() || !IsTracking()) {
+        if (!m_wayfinding || !IsTracking()) {
+            SetObjectsActive(false);
+            return;
+        }
+
+        manager.GetArFrame(frame);
+        if (!frame.converged) {
             SetObjectsActive(false);
             return;
         }
 
         Matrix4x4 matrix;
         if (m_compass) {
-            if ((matrix = manager.GetArCompassMatrix()) != Matrix4x4.identity) {
+            if (frame.hasCompass) {
+                matrix = frame.compass;
                 m_compass.transform.rotation = Quaternion.LookRotation(matrix.GetColumn(2), matrix.GetColumn(1));
                 m_compass.transform.position = matrix.GetColumn(3);
                 m_compass.SetActive(true);
@@ -263,7 +475,8 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
         }
 
         if (m_goal) {
-            if ((matrix = manager.GetArGoalMatrix()) != Matrix4x4.identity) {
+            if (frame.hasGoal) {
+                matrix = frame.goal;
                 m_goal.transform.rotation = Quaternion.LookRotation(matrix.GetColumn(2), matrix.GetColumn(1));
                 m_goal.transform.position = matrix.GetColumn(3);
                 m_goal.SetActive(true);
@@ -272,43 +485,64 @@ public class IndoorAtlasARWayfinding : MonoBehaviour {
             }
         }
 
-        if (turns != null) {
+        if (m_turn) {
+           if (frame.turnCount > turns.Count) EnsureTurns(frame.turnCount); // route callback normally preallocates these
            int t = 0;
-           int count = manager.GetArTurnCount();
-           for (int i = 0; i < count && t < turns.Length; ++i) {
-               if ((matrix = manager.GetArTurnMatrix(i)) != Matrix4x4.identity) {
-                   turns[t].transform.rotation = Quaternion.LookRotation(matrix.GetColumn(2), matrix.GetColumn(1));
-                   turns[t].transform.position = matrix.GetColumn(3);
-                   turns[t].SetActive(true);
-                   ++t;
-               }
+           for (; t < frame.turnCount && t < turns.Count; ++t) {
+               matrix = frame.turns[t];
+               turns[t].transform.rotation = Quaternion.LookRotation(matrix.GetColumn(2), matrix.GetColumn(1));
+               turns[t].transform.position = matrix.GetColumn(3);
+               turns[t].SetActive(true);
            }
-           for (; t < turns.Length; ++t) turns[t].SetActive(false);
+           for (; t < turns.Count; ++t) if (turns[t].activeSelf) turns[t].SetActive(false);
         }
 
-        if (pois != null) {
-           for (int i = 0; i < pois.Length; ++i) {
-               matrix = manager.GeoToAr(pois[i].position.coordinate.latitude, pois[i].position.coordinate.longitude, pois[i].position.floor, 0, 0.2f);
-               poi_objects[i].transform.rotation = Quaternion.LookRotation(matrix.GetColumn(2), matrix.GetColumn(1));
-               poi_objects[i].transform.position = matrix.GetColumn(3);
-               poi_objects[i].transform.LookAt(m_camera.transform);
-               poi_objects[i].transform.Rotate(0, 180, 0);
-               poi_objects[i].SetActive(true);
+        if (poi_anchors != null) {
+           // positions only change when the geo-alignment moves, the labels still face the camera every frame
+           bool moved = poi_anchors.Update(manager);
+           for (int i = 0; i < poi_anchors.count; ++i) {
+               GameObject poi = poi_objects[i];
+               if (moved) poi.transform.position = poi_anchors.matrices[i].GetColumn(3);
+               bool visible = !m_poiFrustumCulling || IsInView(poi.transform.position);
+               if (visible) {
+                   poi.transform.LookAt(m_camera.transform);
+                   poi.transform.Rotate(0, 180, 0);
+               }
+               if (poi.activeSelf != visible) poi.SetActive(visible);
            }
         }
     }
 
-    void IndoorAtlasOnEnterRegion(Region region) {
+    void OnLocationChanged(in LocationData location) {
+        has_location = true;
+        location_latitude = location.latitude;
+        location_longitude = location.longitude;
+        location_floor = location.floor;
+        if (poi_index == null) return;
+        // re-query once moved a fraction of the radius, POIs at the edge may pop in slightly late
+        Vector2 position = poi_index.ToEN(location_latitude, location_longitude);
+        if (poi_anchors.count == 0 || location_floor != poi_query_floor || (position - poi_query_position).magnitude > 0.1f * m_poiRadius) {
+            QueryVisiblePOIs();
+        }
+    }
+
+    void OnRouteUpdated(Route route) {
+        // A route has at most one turn between consecutive legs
+        if (route.legs != null) EnsureTurns(Mathf.Min(route.legs.Length, frame.turns.Length));
+    }
+
+    void OnEnterRegion(Region region) {
         if (region.type == Region.Type.Venue) {
-            pois = region.venue.pois;
-            InstantiatePOIObjects();
+            poi_index = new POIIndex(region.venue.pois);
+            if (poi_objects == null) InstantiatePOIObjects();
+            else QueryVisiblePOIs();
         }
     }
 
-    void IndoorAtlasOnExitRegion(Region region) {
+    void OnExitRegion(Region region) {
         if (region.type == Region.Type.Venue) {
-            DestroyPOIObjects();
-            pois = null;
+            poi_index = null;
+            QueryVisiblePOIs();
         }
     }
 }
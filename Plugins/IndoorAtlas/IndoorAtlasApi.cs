@@ -1,6 +1,8 @@
 using System;
+using System.Collections.Generic;
 using UnityEngine;
 using System.Runtime.InteropServices;
+using Unity.Profiling;
 #if UNITY_ANDROID
 using UnityEngine.Android;
 #endif
@@ -141,7 +143,12 @@ public class Region {
     // Region type.
     public Type type;
     // If this is a venue region then this will point to the venue object
+    // The same Venue object is shared by all events of the venue until its content changes
     public Venue venue;
+    // Id of the venue this region belongs to, if any
+    public string venueId;
+    // Content hash of the venue, changes whenever the venue content changes
+    public string venueHash;
     // If this is a floorplan region then this will point to the floorplan object
     public Floorplan floorplan;
     // If this is a geofence region then this will point to the geofence object
@@ -202,13 +209,274 @@ public class Route {
     public string error;
 }
 
+[Serializable]
+public class ExtraInfo {
+    // Trace ID of the positioning session, empty until the session has started.
+    public string traceId;
+}
+
+// Blittable counterparts of Location, Heading, Orientation, RoutePoint and RouteLeg.
+// All fields are inline so these can be filled from native memory without allocations,
+// stored in NativeArrays and passed to Burst compiled jobs. Use the conversion helpers
+// to get the class versions expected by older code.
+
+[Serializable]
+[StructLayout(LayoutKind.Sequential)]
+public struct LocationData {
+    // Latitude and longitude in degrees.
+    public double latitude, longitude;
+    // Altitude in meters, or 0.0 if not available.
+    public double altitude;
+    // UTC time of this location fix in milliseconds.
+    public long timestamp;
+    // Location accuracy in meters.
+    public float accuracy;
+    // Bearing in degrees, in range of (0.0, 360.0].
+    public float bearing;
+    // Floor level.
+    public int floor;
+
+    internal static LocationData FromRecord(ref EventRecord record) {
+        return new LocationData {
+            latitude = record.v0, longitude = record.v1, altitude = record.v3, timestamp = record.timestamp,
+            accuracy = (float)record.v2, bearing = (float)record.v4, floor = record.floor,
+        };
+    }
+
+    public static LocationData FromLocation(Location location) {
+        return new LocationData {
+            latitude = location.position.coordinate.latitude, longitude = location.position.coordinate.longitude,
+            altitude = location.altitude, timestamp = location.timestamp,
+            accuracy = location.accuracy, bearing = location.bearing, floor = location.position.floor,
+        };
+    }
+
+    // Copies the values to location, which is allocated if null, and returns it.
+    public Location ToLocation(Location location = null) {
+        if (location == null) location = new Location();
+        if (location.position == null) location.position = new LatLngFloor();
+        if (location.position.coordinate == null) location.position.coordinate = new WGS84();
+        location.position.coordinate.latitude = latitude;
+        location.position.coordinate.longitude = longitude;
+        location.position.floor = floor;
+        location.altitude = altitude;
+        location.timestamp = timestamp;
+        location.accuracy = accuracy;
+        location.bearing = bearing;
+        return location;
+    }
+}
+
+[Serializable]
+[StructLayout(LayoutKind.Sequential)]
+public struct HeadingData {
+    // Heading in degrees, 0 is north and 90 east.
+    public double heading;
+    // UTC time of this heading in milliseconds.
+    public long timestamp;
+
+    public static HeadingData FromHeading(Heading heading) {
+        return new HeadingData { heading = heading.heading, timestamp = heading.timestamp };
+    }
+
+    // Copies the values to heading, which is allocated if null, and returns it.
+    public Heading ToHeading(Heading heading = null) {
+        if (heading == null) heading = new Heading();
+        heading.heading = this.heading;
+        heading.timestamp = timestamp;
+        return heading;
+    }
+}
+
+[Serializable]
+[StructLayout(LayoutKind.Sequential)]
+public struct OrientationData {
+    // Orientation quaternion in IndoorAtlas coordinates.
+    public double x, y, z, w;
+    // UTC time of this orientation in milliseconds.
+    public long timestamp;
+
+    public static OrientationData FromOrientation(Orientation orientation) {
+        return new OrientationData { x = orientation.x, y = orientation.y, z = orientation.z, w = orientation.w, timestamp = orientation.timestamp };
+    }
+
+    // Copies the values to orientation, which is allocated if null, and returns it.
+    public Orientation ToOrientation(Orientation orientation = null) {
+        if (orientation == null) orientation = new Orientation();
+        orientation.x = x;
+        orientation.y = y;
+        orientation.z = z;
+        orientation.w = w;
+        orientation.timestamp = timestamp;
+        return orientation;
+    }
+
+    // Orientation of the device in Unity coordinates, as passed to the orientation events.
+    public Quaternion ToUnity() {
+        Quaternion rot = Quaternion.Inverse(new Quaternion((float)x, (float)y, (float)-z, (float)w));
+        return Quaternion.Euler(new Vector3(90.0f, 0.0f, 0.0f)) * rot;
+    }
+}
+
+[Serializable]
+[StructLayout(LayoutKind.Sequential)]
+public struct RoutePointData {
+    // Latitude and longitude in degrees.
+    public double latitude, longitude;
+    // Floor level.
+    public int floor;
+    // Zero-based index of the node in the original JSON graph, -1 for virtual nodes.
+    public int nodeIndex;
+
+    public static RoutePointData FromRoutePoint(RoutePoint point) {
+        return new RoutePointData {
+            latitude = point.position.coordinate.latitude, longitude = point.position.coordinate.longitude,
+            floor = point.position.floor, nodeIndex = point.nodeIndex,
+        };
+    }
+
+    public RoutePoint ToRoutePoint() {
+        return new RoutePoint {
+            position = new LatLngFloor { coordinate = new WGS84 { latitude = latitude, longitude = longitude }, floor = floor },
+            nodeIndex = nodeIndex,
+        };
+    }
+}
+
+[Serializable]
+[StructLayout(LayoutKind.Sequential)]
+public struct RouteLegData {
+    // Starting and ending points of the leg.
+    public RoutePointData begin, end;
+    // Length of the leg in meters.
+    public double length;
+    // Direction of the leg in ENU coordinates in degrees, 0 is North and 90 is East.
+    public double direction;
+    // Zero-based index of the edge in the original JSON graph, -1 for virtual legs.
+    public int edgeIndex;
+
+    public static RouteLegData FromRouteLeg(RouteLeg leg) {
+        return new RouteLegData {
+            begin = RoutePointData.FromRoutePoint(leg.begin), end = RoutePointData.FromRoutePoint(leg.end),
+            length = leg.length, direction = leg.direction, edgeIndex = leg.edgeIndex,
+        };
+    }
+
+    public RouteLeg ToRouteLeg() {
+        return new RouteLeg { begin = begin.ToRoutePoint(), end = end.ToRoutePoint(), length = length, direction = direction, edgeIndex = edgeIndex };
+    }
+
+    // Copies the legs of route to legs, which is grown if too small, and returns the number of legs.
+    public static int FromRoute(Route route, ref RouteLegData[] legs) {
+        int count = (route.legs != null ? route.legs.Length : 0);
+        if (legs == null || legs.Length < count) legs = new RouteLegData[count];
+        for (int i = 0; i < count; ++i) legs[i] = FromRouteLeg(route.legs[i]);
+        return count;
+    }
+}
+
+// AR wayfinding state of a single frame, filled by LocationManager.GetArFrame.
+// Reuse the same instance every frame, it does not allocate after construction.
+public class ArFrame {
+    // Number of floats in the native frame header: converged, valid flags, total turn count, valid turn count.
+    internal const int HeaderSize = 4;
+    internal const int MatrixSize = 16;
+    internal const int ValidCompass = 1 << 0;
+    internal const int ValidGoal = 1 << 1;
+
+    // Whether the AR session has converged, nothing else is valid if this is false.
+    public bool converged;
+    // Whether compass matrix is valid.
+    public bool hasCompass;
+    // Model matrix of the compass arrow in Unity coordinates.
+    public Matrix4x4 compass;
+    // Whether goal matrix is valid.
+    public bool hasGoal;
+    // Model matrix of the goal in Unity coordinates.
+    public Matrix4x4 goal;
+    // Number of valid turn matrices in turns.
+    public int turnCount;
+    // Model matrices of the turn arrows in Unity coordinates, only first turnCount are valid.
+    public readonly Matrix4x4[] turns;
+
+    internal readonly float[] native;
+
+    public ArFrame(int maxTurns = 64) {
+        turns = new Matrix4x4[maxTurns];
+        native = new float[HeaderSize + (2 + maxTurns) * MatrixSize];
+    }
+}
+
 public class LocationManager {
 #if UNITY_ANDROID
     private static AndroidJavaObject jPlugin = null;
+    private static AndroidJavaObject jEventBuffer = null;
+    private static AndroidJavaObject jArFrameBuffer = null;
+    private static IntPtr jArFrameBufferAddress = IntPtr.Zero;
+    private static IntPtr jGetArFrameMethod = IntPtr.Zero;
+    private static readonly jvalue[] jNoArgs = new jvalue[0];
+    // Single matrix exchanged through a direct FloatBuffer, so per frame AR calls do not marshal Java arrays
+    private static AndroidJavaObject jArMatrixBuffer = null;
+    private static IntPtr jArMatrixBufferAddress = IntPtr.Zero;
+    private static IntPtr jSetArPoseMatrixMethod, jSetArCameraToWorldMatrixMethod;
+    private static IntPtr jGetArCompassMatrixMethod, jGetArGoalMatrixMethod, jGetArTurnMatrixMethod, jGeoToArMethod;
+    private static readonly jvalue[] jTurnArgs = new jvalue[1];
+    private static readonly jvalue[] jGeoToArArgs = new jvalue[5];
+    private static readonly float[] jArMatrix = new float[16];
+    // The Java side keeps a reference to the AR to geo buffer, so only its address is kept here
+    private static IntPtr jArToGeoBufferAddress = IntPtr.Zero;
+    private static int jArToGeoCapacity = 0;
+    private static IntPtr jGetArToGeoBufferMethod, jArToGeoManyMethod;
+    private static readonly jvalue[] jArToGeoArgs = new jvalue[1];
+    // Same for the AR plane buffer
+    private static IntPtr jArPlaneBufferAddress = IntPtr.Zero;
+    private static int jArPlaneCapacity = 0;
+    private static IntPtr jGetArPlaneBufferMethod, jAddArPlanesMethod;
+    private static readonly jvalue[] jArPlaneArgs = new jvalue[1];
+    // Same for the geo to AR buffer
+    private static IntPtr jGeoToArBufferAddress = IntPtr.Zero;
+    private static int jGeoToArCapacity = 0;
+    private static IntPtr jGetGeoToArBufferMethod, jGeoToArManyMethod;
+    private static readonly jvalue[] jGeoToArManyArgs = new jvalue[3];
+#elif !UNITY_IOS
+    private static IndoorAtlasReplay replay = null;
+    private static string replayTrace = "";
+    private static float replaySpeed = 1.0f;
 #endif
 
     private static readonly Matrix4x4 m_unityWorldToIndoorAtlasWorld = Matrix4x4.Scale(new Vector3(1, 1, -1));
 
+    // Venues received from the native side, the full venue is only sent once per content hash
+    private static readonly Dictionary<string, Venue> m_venues = new Dictionary<string, Venue>();
+    private static readonly Dictionary<string, string> m_venueHashes = new Dictionary<string, string>();
+
+    // Latest extra info pushed by the native side whenever it changes, read without calling into native code
+    private static ExtraInfo m_extraInfo = new ExtraInfo { traceId = "" };
+
+    // Latest route and the user's progress along it, routes are parsed and post-processed by m_routeCache
+    private static RouteCache m_routeCache = null;
+    private static RouteSnapshot m_route = null;
+    private static LocationData m_routeLocation;
+    private static bool m_hasRouteLocation = false;
+    private static int m_routeLeg = -1;
+    private static double m_routeDistance = 0.0;
+
+    // Profiler markers of the bridge calls, visible in the Unity profiler and in IndoorAtlasBenchmark results
+    private static readonly ProfilerMarker s_parseRegionMarker = new ProfilerMarker("IndoorAtlas.ParseRegion");
+    private static readonly ProfilerMarker s_setArPoseMatrixMarker = new ProfilerMarker("IndoorAtlas.SetArPoseMatrix");
+    private static readonly ProfilerMarker s_setArCameraToWorldMatrixMarker = new ProfilerMarker("IndoorAtlas.SetArCameraToWorldMatrix");
+    private static readonly ProfilerMarker s_getArCompassMatrixMarker = new ProfilerMarker("IndoorAtlas.GetArCompassMatrix");
+    private static readonly ProfilerMarker s_getArGoalMatrixMarker = new ProfilerMarker("IndoorAtlas.GetArGoalMatrix");
+    private static readonly ProfilerMarker s_getArTurnMatrixMarker = new ProfilerMarker("IndoorAtlas.GetArTurnMatrix");
+    private static readonly ProfilerMarker s_getArFrameMarker = new ProfilerMarker("IndoorAtlas.GetArFrame");
+    private static readonly ProfilerMarker s_addArPlanesMarker = new ProfilerMarker("IndoorAtlas.AddArPlanes");
+    private static readonly ProfilerMarker s_geoToArMarker = new ProfilerMarker("IndoorAtlas.GeoToAr");
+    private static readonly ProfilerMarker s_geoToArManyMarker = new ProfilerMarker("IndoorAtlas.GeoToArMany");
+    private static readonly ProfilerMarker s_arToGeoMarker = new ProfilerMarker("IndoorAtlas.ArToGeo");
+
+    // Records the AR matrices passed to the SDK when set
+    private static SessionRecorder m_recorder = null;
+
 #if UNITY_IOS
     [DllImport("__Internal")] private static extern bool indooratlas_init(string apikey, string apisecret, string apiEndpoint, string session);
 #endif
@@ -231,7 +499,72 @@ public class LocationManager {
         AndroidJavaObject jApiSecret = new AndroidJavaObject("java.lang.String", apiSecret);
         AndroidJavaObject jApiEndpoint = new AndroidJavaObject("java.lang.String", apiEndpoint);
         AndroidJavaObject jSession = new AndroidJavaObject("java.lang.String", session);
+        CheckAndroidBridgeVersion();
         jPlugin = new AndroidJavaObject("com.indooratlas.android.unity.Plugin", jActivity, jApiKey, jApiSecret, jApiEndpoint, jSession);
+#else
+        string trace = replayTrace;
+        float speed = replaySpeed;
+        IndoorAtlasReplay.ResolveCommandLine(ref trace, ref speed);
+        if (!string.IsNullOrEmpty(trace)) replay = IndoorAtlasReplay.Create(trace, speed, session);
+#endif
+    }
+
+#if UNITY_ANDROID
+    // Version of the Java bridge this file is written against, see Plugin.BRIDGE_VERSION
+    private const int AndroidBridgeVersion = 5;
+
+    // Fails early with a clear message instead of missing method errors on every later call
+    // when androidwrapper.aar was not rebuilt after the Java sources changed
+    static void CheckAndroidBridgeVersion() {
+        int version = 0;
+        try {
+            using (var plugin = new AndroidJavaClass("com.indooratlas.android.unity.Plugin")) {
+                version = plugin.GetStatic<int>("BRIDGE_VERSION");
+            }
+        } catch (AndroidJavaException) {
+        }
+        if (version != AndroidBridgeVersion) {
+            throw new InvalidOperationException("IndoorAtlas: androidwrapper.aar is out of date (bridge version " + version +
+                    ", expected " + AndroidBridgeVersion + "), rebuild it with ./gradlew assembleRelease in androidwrapper");
+        }
+    }
+#endif
+
+    // True once the SDK has been created. On Android it is created asynchronously on the UI thread after Init returns,
+    // calls made before that are queued in order. iOS and the replay backend are ready as soon as Init returns.
+    public bool IsReady() {
+#if UNITY_ANDROID
+        return jPlugin != null && jPlugin.Call<bool>("isReady");
+#else
+        return true;
+#endif
+    }
+
+    // True once the AR session exists. On Android the first AR call requests it asynchronously and
+    // AR calls return identity matrices, no turns and not converged until it is ready.
+    public bool IsArReady() {
+#if UNITY_ANDROID
+        return jPlugin != null && jPlugin.Call<bool>("isArReady");
+#else
+        return true;
+#endif
+    }
+
+    // Sets the trace replayed by Init on platforms other than iOS and Android, blank for none
+    // Do not call this manually, this is handled by IndoorAtlasSession game object!
+    public void SetReplay(string trace, float speed) {
+#if !UNITY_IOS && !UNITY_ANDROID
+        replayTrace = trace;
+        replaySpeed = speed;
+#endif
+    }
+
+    // Returns the replay backend on platforms other than iOS and Android, or null if no trace is replayed
+    public IndoorAtlasReplay GetReplay() {
+#if !UNITY_IOS && !UNITY_ANDROID
+        return replay;
+#else
+        return null;
 #endif
     }
 
@@ -249,6 +582,163 @@ public class LocationManager {
 #elif UNITY_ANDROID
         jPlugin.Call("close");
         jPlugin = null;
+        jEventBuffer = null;
+        m_eventBufferAddress = IntPtr.Zero;
+        jArFrameBuffer = null;
+        jArFrameBufferAddress = IntPtr.Zero;
+        jGetArFrameMethod = IntPtr.Zero;
+        jArMatrixBuffer = null;
+        jArMatrixBufferAddress = IntPtr.Zero;
+        jArToGeoBufferAddress = IntPtr.Zero;
+        jArToGeoCapacity = 0;
+        jArToGeoManyMethod = IntPtr.Zero;
+        jGeoToArBufferAddress = IntPtr.Zero;
+        jGeoToArCapacity = 0;
+        jGeoToArManyMethod = IntPtr.Zero;
+        jArPlaneBufferAddress = IntPtr.Zero;
+        jArPlaneCapacity = 0;
+        jAddArPlanesMethod = IntPtr.Zero;
+#else
+        if (replay) UnityEngine.Object.Destroy(replay.gameObject);
+        replay = null;
+#endif
+        m_venues.Clear();
+        m_venueHashes.Clear();
+        m_extraInfo = new ExtraInfo { traceId = "" };
+        if (m_routeCache != null) m_routeCache.Dispose();
+        m_routeCache = null;
+        m_route = null;
+        m_hasRouteLocation = false;
+        m_routeLeg = -1;
+    }
+
+    // Sets the recorder that captures the AR pose and camera matrices, null to stop capturing
+    // Do not call this manually, this is handled by IndoorAtlasSession game object!
+    public void SetRecorder(SessionRecorder recorder) {
+        m_recorder = recorder;
+    }
+
+    // Returns the cached venue with the given id, or null if the venue has not been entered during this session
+    public Venue GetVenue(string id) {
+        Venue venue;
+        return (id != null && m_venues.TryGetValue(id, out venue) ? venue : null);
+    }
+
+    // Parses region event sent by the native side and resolves its venue from the venue cache
+    // Do not call this manually, this is handled by IndoorAtlasSession game object!
+    public Region ParseRegion(string data) {
+        using (s_parseRegionMarker.Auto()) {
+            Region region = JsonUtility.FromJson<Region>(data);
+            if (string.IsNullOrEmpty(region.venueId)) return region;
+            if (region.venue != null && region.venue.id == region.venueId) {
+                m_venues[region.venueId] = region.venue;
+                m_venueHashes[region.venueId] = region.venueHash;
+            } else {
+                Venue venue = GetVenue(region.venueId);
+                if (venue != null) {
+                    region.venue = venue;
+                    if (m_venueHashes[region.venueId] != region.venueHash)
+                        Debug.LogWarning("IndoorAtlas: venue " + region.venueId + " changed but was not resent");
+                } else {
+                    Debug.LogWarning("IndoorAtlas: venue " + region.venueId + " is not cached");
+                }
+            }
+            return region;
+        }
+    }
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern void indooratlas_setEventTransport(int transport);
+#endif
+    // Selects how location, heading and orientation events are delivered to the session
+    // Do not call this manually, this is handled by IndoorAtlasSession game object!
+    public void SetEventTransport(EventTransport transport) {
+#if UNITY_IOS
+        indooratlas_setEventTransport((int)transport);
+#elif UNITY_ANDROID
+        jPlugin.Call("setEventTransport", (int)transport);
+#else
+        if (replay) replay.transport = transport;
+#endif
+    }
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern void indooratlas_setEventRateLimit(int type, double interval);
+#endif
+    // Limits events of the given type to at most maxRate per second (0 for no limit). The native side
+    // coalesces events arriving faster, delivering only the latest one, and counts the replaced ones as dropped.
+    public void SetEventRateLimit(EventType type, double maxRate) {
+        double interval = (maxRate > 0 ? 1.0 / maxRate : 0);
+#if UNITY_IOS
+        indooratlas_setEventRateLimit((int)type, interval);
+#elif UNITY_ANDROID
+        jPlugin.Call("setEventRateLimit", (int)type, interval);
+#endif
+    }
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern IntPtr indooratlas_eventBuffer();
+#endif
+#if UNITY_IOS || UNITY_ANDROID
+    private static IntPtr m_eventBufferAddress = IntPtr.Zero;
+
+    private static IntPtr EventBufferAddress() {
+        if (m_eventBufferAddress != IntPtr.Zero) return m_eventBufferAddress;
+#if UNITY_IOS
+        m_eventBufferAddress = indooratlas_eventBuffer();
+#else
+        // Keep reference to the direct ByteBuffer so that its memory stays valid
+        jEventBuffer = jPlugin.Call<AndroidJavaObject>("getEventBuffer");
+        m_eventBufferAddress = AndroidJNI.GetDirectBufferAddress(jEventBuffer.GetRawObject());
+#endif
+        return m_eventBufferAddress;
+    }
+#endif
+
+    // Returns reader for the event buffer shared with the native side, or null if not available
+    internal EventBuffer GetEventBuffer() {
+#if UNITY_IOS || UNITY_ANDROID
+        return new EventBuffer(EventBufferAddress());
+#else
+        return (replay ? replay.events : null);
+#endif
+    }
+
+    // Returns version of the geo to AR alignment, which changes whenever the AR session converges, loses convergence
+    // or re-aligns, so that the results of GeoToAr and GeoToArMany change. The native side tracks it while setting
+    // the AR pose and publishes it in the event buffer, so this does not call into native code.
+    public int GetArAlignmentVersion() {
+#if UNITY_IOS || UNITY_ANDROID
+        return EventBuffer.ReadArAlignment(EventBufferAddress());
+#else
+        return 0;
+#endif
+    }
+
+    // Native serializers measured by BenchmarkSerializer
+    internal enum Serializer : int {
+        // Location event for the JSON transport
+        Location = 0,
+        // Latest entered region including its venue
+        RegionWithVenue = 1,
+        // Latest entered region referring to its already sent venue
+        Region = 2,
+    };
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern int indooratlas_benchmarkSerializer(int serializer, int iterations, [Out] double[] microseconds);
+#endif
+    // Runs the native serializer microseconds.Length times and stores the duration of each run, returns the number
+    // of runs. Returns 0 if there is nothing to serialize yet (no region entered) or on platforms without one.
+    internal int BenchmarkSerializer(Serializer serializer, double[] microseconds) {
+#if UNITY_IOS
+        return indooratlas_benchmarkSerializer((int)serializer, microseconds.Length, microseconds);
+#elif UNITY_ANDROID
+        double[] result = jPlugin.Call<double[]>("benchmarkSerializer", (int)serializer, microseconds.Length);
+        Array.Copy(result, microseconds, result.Length);
+        return result.Length;
+#else
+        return 0;
 #endif
     }
 
@@ -405,6 +895,8 @@ public class LocationManager {
         indooratlas_startUpdatingLocation();
 #elif UNITY_ANDROID
         jPlugin.Call("startUpdatingLocation");
+#else
+        if (replay) replay.Play();
 #endif
     }
 
@@ -419,6 +911,8 @@ public class LocationManager {
         indooratlas_stopUpdatingLocation();
 #elif UNITY_ANDROID
         jPlugin.Call("stopUpdatingLocation");
+#else
+        if (replay) replay.Pause();
 #endif
     }
 
@@ -447,17 +941,80 @@ public class LocationManager {
 #endif
     }
 
-#if UNITY_IOS
-    [DllImport("__Internal")] private static extern string indooratlas_traceID();
-#endif
+    // Returns the trace ID of the positioning session, empty until it has started
+    // On replay this is the trace ID recorded in the trace, empty if it has none
     public string GetTraceId() {
-#if UNITY_IOS
-        return indooratlas_traceID();
-#elif UNITY_ANDROID
-        return jPlugin.Call<string>("getTraceId");
-#else
-        return "";
-#endif
+        return m_extraInfo.traceId;
+    }
+
+    // Returns the latest extra info snapshot, do not modify it
+    public ExtraInfo GetExtraInfo() {
+        return m_extraInfo;
+    }
+
+    // Parses extra info sent by the native side and replaces the snapshot
+    // Returns null if nothing changed
+    internal ExtraInfo ParseExtraInfo(string data) {
+        ExtraInfo info = JsonUtility.FromJson<ExtraInfo>(data);
+        if (info.traceId == null) info.traceId = "";
+        if (info.traceId == m_extraInfo.traceId) return null;
+        m_extraInfo = info;
+        return info;
+    }
+
+    // Hands route event sent by the native side to the background thread that parses it
+    // Do not call this manually, this is handled by IndoorAtlasSession game object!
+    internal void SubmitRoute(string data) {
+        if (m_routeCache == null) m_routeCache = new RouteCache();
+        m_routeCache.Submit(data);
+    }
+
+    // Returns the route that finished processing since the last call and makes it current, or null
+    // Do not call this manually, this is handled by IndoorAtlasSession game object!
+    internal RouteSnapshot TakeRoute() {
+        RouteSnapshot route = (m_routeCache != null ? m_routeCache.Take() : null);
+        if (route == null) return null;
+        m_route = route;
+        m_routeLeg = -1;
+        m_routeDistance = 0.0;
+        if (m_hasRouteLocation) UpdateRouteProgress(in m_routeLocation);
+        return route;
+    }
+
+    // Locates the user on the current route
+    // Do not call this manually, this is handled by IndoorAtlasSession game object!
+    internal void UpdateRouteProgress(in LocationData location) {
+        m_routeLocation = location;
+        m_hasRouteLocation = true;
+        if (m_route == null) return;
+        int leg;
+        double distance;
+        if (m_route.Locate(location.latitude, location.longitude, location.floor, out leg, out distance)) {
+            m_routeLeg = leg;
+            m_routeDistance = distance;
+        }
+    }
+
+    // Returns the latest route with its derived data, or null if no route has been received
+    public RouteSnapshot GetRoute() {
+        return m_route;
+    }
+
+    // Returns the index of the route leg closest to the latest location, or -1 if not known
+    public int GetRouteLeg() {
+        return m_routeLeg;
+    }
+
+    // Returns the distance in meters from the latest location to the end of the route along the route
+    public double GetRemainingRouteDistance() {
+        if (m_route == null) return 0.0;
+        return (m_routeLeg >= 0 ? m_route.length - m_routeDistance : m_route.length);
+    }
+
+    // Returns the index of the next turn of the route (see RouteSnapshot.GetTurnLeg), or -1 if there are no more turns
+    public int GetNextRouteTurn() {
+        if (m_route == null) return -1;
+        return m_route.GetNextTurn(m_routeLeg);
     }
 
 #if UNITY_IOS
@@ -471,53 +1028,98 @@ public class LocationManager {
 #endif
     }
 
+    // The handedness change is a mirror along z, so converting needs only sign flips instead of matrix multiplies.
+    static void FlipUnityAndIndoorAtlasWorld(ref Matrix4x4 matrix) {
+        // S * matrix * S with S = diag(1, 1, -1, 1): negate row 2 and column 2, m22 flips twice
+        matrix.m20 = -matrix.m20; matrix.m21 = -matrix.m21; matrix.m23 = -matrix.m23;
+        matrix.m02 = -matrix.m02; matrix.m12 = -matrix.m12; matrix.m32 = -matrix.m32;
+    }
+
+    static void FlipIndoorAtlasToUnityWorld(ref Matrix4x4 matrix) {
+        // S * matrix: negate row 2
+        matrix.m20 = -matrix.m20; matrix.m21 = -matrix.m21; matrix.m22 = -matrix.m22; matrix.m23 = -matrix.m23;
+    }
+
     static public Matrix4x4 UnityMatrixToIndoorAtlasMatrix(Matrix4x4 matrix) {
         // Convert Unity left-handed matrices to IndoorAtlas right-handed matrices.
-        return m_unityWorldToIndoorAtlasWorld * matrix * m_unityWorldToIndoorAtlasWorld;
+        FlipUnityAndIndoorAtlasWorld(ref matrix);
+        return matrix;
     }
 
     static public Matrix4x4 IndoorAtlasMatrixToUnityMatrix(Matrix4x4 matrix) {
         // Convert IndoorAtlas right-handed matrices to Unity left-handed matrices.
-        return m_unityWorldToIndoorAtlasWorld * matrix;
+        FlipIndoorAtlasToUnityWorld(ref matrix);
+        return matrix;
     }
 
 #if UNITY_IOS
-    [DllImport("__Internal")] private static extern void indooratlas_setArPoseMatrix(float[] matrix);
+    // The iOS SDK internally transforms ARKit pose matrix to IndoorAtlas compatible matrix.
+    // However, ARFoundation's pose matrix is already transformed from ARKit to Unity's left-handed world coordinates.
+    // The inverse of the ARKit transformation is applied to make the transformation in SDK no-op.
+    static readonly Matrix4x4 s_arKitInverse = new Matrix4x4(
+            new Vector4(0, -1, 0, 0), new Vector4(1, 0, 0, 0), new Vector4(0, 0, 1, 0), new Vector4(0, 0, 0, 1));
 #endif
-    public void SetArPoseMatrix(Matrix4x4 matrix) {
-        matrix = UnityMatrixToIndoorAtlasMatrix(matrix);
+
+#if UNITY_ANDROID
+    static void InitArMatrixBuffer() {
+        if (jArMatrixBufferAddress != IntPtr.Zero) return;
+        jArMatrixBuffer = jPlugin.Call<AndroidJavaObject>("getArMatrixBuffer");
+        jArMatrixBufferAddress = AndroidJNI.GetDirectBufferAddress(jArMatrixBuffer.GetRawObject());
+        IntPtr c = jPlugin.GetRawClass();
+        jSetArPoseMatrixMethod = AndroidJNIHelper.GetMethodID(c, "setArPoseMatrixFromBuffer", "()V");
+        jSetArCameraToWorldMatrixMethod = AndroidJNIHelper.GetMethodID(c, "setArCameraToWorldMatrixFromBuffer", "()V");
+        jGetArCompassMatrixMethod = AndroidJNIHelper.GetMethodID(c, "getArCompassMatrixToBuffer", "()Z");
+        jGetArGoalMatrixMethod = AndroidJNIHelper.GetMethodID(c, "getArGoalMatrixToBuffer", "()Z");
+        jGetArTurnMatrixMethod = AndroidJNIHelper.GetMethodID(c, "getArTurnMatrixToBuffer", "(I)Z");
+        jGeoToArMethod = AndroidJNIHelper.GetMethodID(c, "geoToArToBuffer", "(DDIFF)Z");
+    }
+
+    static void WriteArMatrix(ref Matrix4x4 matrix) {
+        InitArMatrixBuffer();
+        for (int i = 0; i < 16; ++i) jArMatrix[i] = matrix[i];
+        Marshal.Copy(jArMatrix, 0, jArMatrixBufferAddress, 16);
+    }
+
+    static bool ReadArMatrix(bool valid, out Matrix4x4 matrix) {
+        matrix = Matrix4x4.identity;
+        if (!valid) return false;
+        Marshal.Copy(jArMatrixBufferAddress, jArMatrix, 0, 16);
+        for (int i = 0; i < 16; ++i) matrix[i] = jArMatrix[i];
+        return true;
+    }
+#endif
+
 #if UNITY_IOS
-        // The iOS SDK internally transforms ARKit pose matrix to IndoorAtlas compatible matrix.
-        // However, ARFoundation's pose matrix is already transformed from ARKit to Unity's left-handed world coordinates.
-        // Apply inverse of ARKit transformation here to make the transformation in SDK no-op.
-        Matrix4x4 arKitInverse = Matrix4x4.zero;
-        arKitInverse[1,0] = -1;
-        arKitInverse[0,1] =  1;
-        arKitInverse[2,2] =  1;
-        arKitInverse[3,3] =  1;
-        matrix *= arKitInverse;
+    [DllImport("__Internal")] private static extern void indooratlas_setArPoseMatrix(ref Matrix4x4 matrix);
 #endif
-        float[] native = new float[16];
-        for (int i = 0; i < 16; ++i) native[i] = matrix[i];
+    public void SetArPoseMatrix(Matrix4x4 matrix) {
+        using (s_setArPoseMatrixMarker.Auto()) {
+            if (m_recorder != null) m_recorder.RecordMatrix(TraceRecordKind.ArPose, matrix);
+            FlipUnityAndIndoorAtlasWorld(ref matrix);
 #if UNITY_IOS
-        indooratlas_setArPoseMatrix(native);
+            matrix *= s_arKitInverse;
+            indooratlas_setArPoseMatrix(ref matrix);
 #elif UNITY_ANDROID
-        jPlugin.Call("setArPoseMatrix", native);
+            WriteArMatrix(ref matrix);
+            AndroidJNI.CallVoidMethod(jPlugin.GetRawObject(), jSetArPoseMatrixMethod, jNoArgs);
 #endif
+        }
     }
 
 #if UNITY_IOS
-    [DllImport("__Internal")] private static extern void indooratlas_setArCameraToWorldMatrix(float[] matrix);
+    [DllImport("__Internal")] private static extern void indooratlas_setArCameraToWorldMatrix(ref Matrix4x4 matrix);
 #endif
     public void SetArCameraToWorldMatrix(Matrix4x4 matrix) {
-        matrix = IndoorAtlasMatrixToUnityMatrix(matrix);
-        float[] native = new float[16];
-        for (int i = 0; i < 16; ++i) native[i] = matrix[i];
+        using (s_setArCameraToWorldMatrixMarker.Auto()) {
+            if (m_recorder != null) m_recorder.RecordMatrix(TraceRecordKind.ArCameraToWorld, matrix);
+            FlipIndoorAtlasToUnityWorld(ref matrix);
 #if UNITY_IOS
-        indooratlas_setArCameraToWorldMatrix(native);
+            indooratlas_setArCameraToWorldMatrix(ref matrix);
 #elif UNITY_ANDROID
-        jPlugin.Call("setArCameraToWorldMatrix", native);
+            WriteArMatrix(ref matrix);
+            AndroidJNI.CallVoidMethod(jPlugin.GetRawObject(), jSetArCameraToWorldMatrixMethod, jNoArgs);
 #endif
+        }
     }
 
 #if UNITY_IOS
@@ -534,33 +1136,41 @@ public class LocationManager {
     }
 
 #if UNITY_IOS
-    [DllImport("__Internal")] private static extern bool indooratlas_getArCompassMatrix(float[] matrix);
+    [DllImport("__Internal")] private static extern bool indooratlas_getArCompassMatrix(out Matrix4x4 matrix);
 #endif
     public Matrix4x4 GetArCompassMatrix() {
-        Matrix4x4 matrix = Matrix4x4.identity;
+        using (s_getArCompassMatrixMarker.Auto()) {
+            Matrix4x4 matrix = Matrix4x4.identity;
+            bool valid = false;
 #if UNITY_IOS
-        float[] native = new float[16];
-        if (indooratlas_getArCompassMatrix(native)) for (int i = 0; i < 16; ++i) matrix[i] = native[i];
+            valid = indooratlas_getArCompassMatrix(out matrix);
 #elif UNITY_ANDROID
-        float[] native = jPlugin.Call<float[]>("getArCompassMatrix");
-        if (native.Length == 16) for (int i = 0; i < 16; ++i) matrix[i] = native[i];
+            InitArMatrixBuffer();
+            valid = ReadArMatrix(AndroidJNI.CallBooleanMethod(jPlugin.GetRawObject(), jGetArCompassMatrixMethod, jNoArgs), out matrix);
 #endif
-        return (matrix != Matrix4x4.identity ? IndoorAtlasMatrixToUnityMatrix(matrix) : matrix);
+            if (!valid) return Matrix4x4.identity;
+            FlipIndoorAtlasToUnityWorld(ref matrix);
+            return matrix;
+        }
     }
 
 #if UNITY_IOS
-    [DllImport("__Internal")] private static extern bool indooratlas_getArGoalMatrix(float[] matrix);
+    [DllImport("__Internal")] private static extern bool indooratlas_getArGoalMatrix(out Matrix4x4 matrix);
 #endif
     public Matrix4x4 GetArGoalMatrix() {
-        Matrix4x4 matrix = Matrix4x4.identity;
+        using (s_getArGoalMatrixMarker.Auto()) {
+            Matrix4x4 matrix = Matrix4x4.identity;
+            bool valid = false;
 #if UNITY_IOS
-        float[] native = new float[16];
-        if (indooratlas_getArGoalMatrix(native)) for (int i = 0; i < 16; ++i) matrix[i] = native[i];
+            valid = indooratlas_getArGoalMatrix(out matrix);
 #elif UNITY_ANDROID
-        float[] native = jPlugin.Call<float[]>("getArGoalMatrix");
-        if (native.Length == 16) for (int i = 0; i < 16; ++i) matrix[i] = native[i];
+            InitArMatrixBuffer();
+            valid = ReadArMatrix(AndroidJNI.CallBooleanMethod(jPlugin.GetRawObject(), jGetArGoalMatrixMethod, jNoArgs), out matrix);
 #endif
-        return (matrix != Matrix4x4.identity ? IndoorAtlasMatrixToUnityMatrix(matrix) : matrix);
+            if (!valid) return Matrix4x4.identity;
+            FlipIndoorAtlasToUnityWorld(ref matrix);
+            return matrix;
+        }
     }
 
 #if UNITY_IOS
@@ -577,18 +1187,65 @@ public class LocationManager {
     }
 
 #if UNITY_IOS
-    [DllImport("__Internal")] private static extern bool indooratlas_getArTurnMatrix(int index, float[] matrix);
+    [DllImport("__Internal")] private static extern bool indooratlas_getArTurnMatrix(int index, out Matrix4x4 matrix);
 #endif
     public Matrix4x4 GetArTurnMatrix(int index) {
-        Matrix4x4 matrix = Matrix4x4.identity;
+        using (s_getArTurnMatrixMarker.Auto()) {
+            Matrix4x4 matrix = Matrix4x4.identity;
+            bool valid = false;
 #if UNITY_IOS
-        float[] native = new float[16];
-        if (indooratlas_getArTurnMatrix(index, native)) for (int i = 0; i < 16; ++i) matrix[i] = native[i];
+            valid = indooratlas_getArTurnMatrix(index, out matrix);
 #elif UNITY_ANDROID
-        float[] native = jPlugin.Call<float[]>("getArTurnMatrix", index);
-        if (native.Length == 16) for (int i = 0; i < 16; ++i) matrix[i] = native[i];
-#endif
-        return (matrix != Matrix4x4.identity ? IndoorAtlasMatrixToUnityMatrix(matrix) : matrix);
+            InitArMatrixBuffer();
+            jTurnArgs[0].i = index;
+            valid = ReadArMatrix(AndroidJNI.CallBooleanMethod(jPlugin.GetRawObject(), jGetArTurnMatrixMethod, jTurnArgs), out matrix);
+#endif
+            if (!valid) return Matrix4x4.identity;
+            FlipIndoorAtlasToUnityWorld(ref matrix);
+            return matrix;
+        }
+    }
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern int indooratlas_getArFrame(float[] frame, int capacity);
+#endif
+    // Fills frame with the converged flag, compass, goal and turn matrices in a single native call.
+    // This is equivalent to calling GetArIsConverged, GetArCompassMatrix, GetArGoalMatrix,
+    // GetArTurnCount and GetArTurnMatrix for every turn, but without any allocations.
+    public void GetArFrame(ArFrame frame) {
+        using (s_getArFrameMarker.Auto()) {
+            int count = 0;
+            float[] native = frame.native;
+#if UNITY_IOS
+            count = indooratlas_getArFrame(native, native.Length);
+#elif UNITY_ANDROID
+            if (jGetArFrameMethod == IntPtr.Zero) {
+                jArFrameBuffer = jPlugin.Call<AndroidJavaObject>("getArFrameBuffer");
+                jArFrameBufferAddress = AndroidJNI.GetDirectBufferAddress(jArFrameBuffer.GetRawObject());
+                jGetArFrameMethod = AndroidJNIHelper.GetMethodID(jPlugin.GetRawClass(), "getArFrame", "()I");
+            }
+            count = Math.Min(AndroidJNI.CallIntMethod(jPlugin.GetRawObject(), jGetArFrameMethod, jNoArgs), native.Length);
+            if (count > 0) Marshal.Copy(jArFrameBufferAddress, native, 0, count);
+#endif
+            frame.converged = (count >= ArFrame.HeaderSize && native[0] != 0);
+            frame.hasCompass = frame.hasGoal = false;
+            frame.turnCount = 0;
+            if (!frame.converged) return;
+
+            int flags = (int)native[1];
+            if ((frame.hasCompass = (flags & ArFrame.ValidCompass) != 0)) frame.compass = NativeFrameMatrix(native, 0);
+            if ((frame.hasGoal = (flags & ArFrame.ValidGoal) != 0)) frame.goal = NativeFrameMatrix(native, 1);
+            frame.turnCount = Math.Min((int)native[3], frame.turns.Length);
+            for (int i = 0; i < frame.turnCount; ++i) frame.turns[i] = NativeFrameMatrix(native, 2 + i);
+        }
+    }
+
+    static Matrix4x4 NativeFrameMatrix(float[] native, int index) {
+        Matrix4x4 matrix = Matrix4x4.identity;
+        int offset = ArFrame.HeaderSize + index * ArFrame.MatrixSize;
+        for (int i = 0; i < 16; ++i) matrix[i] = native[offset + i];
+        FlipIndoorAtlasToUnityWorld(ref matrix);
+        return matrix;
     }
 
 #if UNITY_IOS
@@ -600,39 +1257,237 @@ public class LocationManager {
 #if UNITY_IOS
         indooratlas_addArPlane(c.x, c.y, c.z, e.x, e.z);
 #elif UNITY_ANDROID
-        jPlugin.Call("addArPlane", c.x, c.y, c.z, e.x, e.z);
+        IntPtr buffer = GetArPlaneBuffer(1);
+        m_arPlane[0] = c.x;
+        m_arPlane[1] = c.y;
+        m_arPlane[2] = c.z;
+        m_arPlane[3] = e.x;
+        m_arPlane[4] = e.z;
+        Marshal.Copy(m_arPlane, 0, buffer, ArPlaneStride);
+        jArPlaneArgs[0].i = 1;
+        AndroidJNI.CallVoidMethod(jPlugin.GetRawObject(), jAddArPlanesMethod, jArPlaneArgs);
 #endif
     }
 
+    // Number of floats per plane in AddArPlanes: center x, y, z and extent x, z
+    public const int ArPlaneStride = 5;
+    private float[] m_arPlanes = new float[0];
+    private readonly float[] m_arPlane = new float[ArPlaneStride];
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern void indooratlas_addArPlanes(float[] data, int count);
+#endif
+    // Batched version of AddArPlane. The planes are packed ArPlaneStride floats each in Unity world coordinates,
+    // only the first count planes are added.
+    public void AddArPlanes(float[] planes, int count) {
+        using (s_addArPlanesMarker.Auto()) {
+            if (count <= 0) return;
+            if (m_arPlanes.Length < count * ArPlaneStride) m_arPlanes = new float[count * ArPlaneStride];
+            for (int i = 0; i < count; ++i) {
+                int o = i * ArPlaneStride;
+                Vector3 c = m_unityWorldToIndoorAtlasWorld.MultiplyPoint3x4(new Vector3(planes[o], planes[o + 1], planes[o + 2]));
+                Vector3 e = m_unityWorldToIndoorAtlasWorld.MultiplyPoint3x4(new Vector3(planes[o + 3], 0, planes[o + 4]));
+                m_arPlanes[o] = c.x;
+                m_arPlanes[o + 1] = c.y;
+                m_arPlanes[o + 2] = c.z;
+                m_arPlanes[o + 3] = e.x;
+                m_arPlanes[o + 4] = e.z;
+            }
 #if UNITY_IOS
-    [DllImport("__Internal")] private static extern void indooratlas_geoToAr(double lat, double lon, int floor, float heading, float zOffset, float[] matrix);
+            indooratlas_addArPlanes(m_arPlanes, count);
+#elif UNITY_ANDROID
+            Marshal.Copy(m_arPlanes, 0, GetArPlaneBuffer(count), count * ArPlaneStride);
+            jArPlaneArgs[0].i = count;
+            AndroidJNI.CallVoidMethod(jPlugin.GetRawObject(), jAddArPlanesMethod, jArPlaneArgs);
+#endif
+        }
+    }
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern void indooratlas_geoToAr(double lat, double lon, int floor, float heading, float zOffset, out Matrix4x4 matrix);
 #endif
     public Matrix4x4 GeoToAr(double lat, double lon, int floor, float heading, float zOffset) {
-        Matrix4x4 matrix = Matrix4x4.identity;
+        using (s_geoToArMarker.Auto()) {
+            Matrix4x4 matrix = Matrix4x4.identity;
 #if UNITY_IOS
-        float[] native = new float[16];
-        indooratlas_geoToAr(lat, lon, floor, heading, zOffset, native);
-        for (int i = 0; i < 16; ++i) matrix[i] = native[i];
+            indooratlas_geoToAr(lat, lon, floor, heading, zOffset, out matrix);
 #elif UNITY_ANDROID
-        float[] native = jPlugin.Call<float[]>("geoToAr", lat, lon, floor, heading, zOffset);
-        if (native.Length == 16) for (int i = 0; i < 16; ++i) matrix[i] = native[i];
+            InitArMatrixBuffer();
+            jGeoToArArgs[0].d = lat;
+            jGeoToArArgs[1].d = lon;
+            jGeoToArArgs[2].i = floor;
+            jGeoToArArgs[3].f = heading;
+            jGeoToArArgs[4].f = zOffset;
+            ReadArMatrix(AndroidJNI.CallBooleanMethod(jPlugin.GetRawObject(), jGeoToArMethod, jGeoToArArgs), out matrix);
+#endif
+            if (matrix != Matrix4x4.identity) FlipIndoorAtlasToUnityWorld(ref matrix);
+            return matrix;
+        }
+    }
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern void indooratlas_geoToArMany(double[] lat, double[] lon, int[] floor, int count, float heading, float zOffset, [Out] Matrix4x4[] matrices);
 #endif
-        return (matrix != Matrix4x4.identity ? IndoorAtlasMatrixToUnityMatrix(matrix) : matrix);
+    // Batched version of GeoToAr, converts count = min(lat.Length, lon.Length, floor.Length, matrices.Length)
+    // coordinates with a single native call. Matrices that could not be converted are set to identity.
+    public void GeoToArMany(double[] lat, double[] lon, int[] floor, Matrix4x4[] matrices, float heading = 0, float zOffset = 0) {
+        GeoToArMany(lat, lon, floor, matrices, Math.Min(Math.Min(lat.Length, lon.Length), Math.Min(floor.Length, matrices.Length)), heading, zOffset);
     }
 
+    // Batched version of GeoToAr for the first count elements of the arrays.
+    public void GeoToArMany(double[] lat, double[] lon, int[] floor, Matrix4x4[] matrices, int count, float heading, float zOffset) {
+        using (s_geoToArManyMarker.Auto()) {
+            if (count <= 0) return;
 #if UNITY_IOS
-    [DllImport("__Internal")] private static extern string indooratlas_arToGeo(double x, double y, double z);
+            indooratlas_geoToArMany(lat, lon, floor, count, heading, zOffset, matrices);
+#elif UNITY_ANDROID
+            IntPtr buffer = GetGeoToArBuffer(count);
+            for (int i = 0; i < count; ++i) {
+                int o = i * GeoToArRecordSize;
+                Marshal.WriteInt64(buffer, o, BitConverter.DoubleToInt64Bits(lat[i]));
+                Marshal.WriteInt64(buffer, o + 8, BitConverter.DoubleToInt64Bits(lon[i]));
+                Marshal.WriteInt32(buffer, o + 16, floor[i]);
+            }
+            jGeoToArManyArgs[0].i = count;
+            jGeoToArManyArgs[1].f = heading;
+            jGeoToArManyArgs[2].f = zOffset;
+            AndroidJNI.CallIntMethod(jPlugin.GetRawObject(), jGeoToArManyMethod, jGeoToArManyArgs);
+            for (int i = 0; i < count; ++i) {
+                Marshal.Copy(IntPtr.Add(buffer, i * GeoToArRecordSize), jArMatrix, 0, 16);
+                Matrix4x4 matrix = new Matrix4x4();
+                for (int j = 0; j < 16; ++j) matrix[j] = jArMatrix[j];
+                matrices[i] = matrix;
+            }
+#else
+            for (int i = 0; i < count; ++i) matrices[i] = Matrix4x4.identity;
 #endif
+            for (int i = 0; i < count; ++i) {
+                if (matrices[i] != Matrix4x4.identity) FlipIndoorAtlasToUnityWorld(ref matrices[i]);
+            }
+        }
+    }
+
+    private readonly Vector3[] m_arToGeoPoint = new Vector3[1];
+    private readonly LocationData[] m_arToGeoLocation = new LocationData[1];
+
+    // Returns null if the point could not be converted
     public Location ArToGeo(float x, float y, float z) {
-        Vector3 c = m_unityWorldToIndoorAtlasWorld.MultiplyPoint3x4(new Vector3(x, y, z));
+        m_arToGeoPoint[0] = new Vector3(x, y, z);
+        if (ArToGeoMany(m_arToGeoPoint, m_arToGeoLocation, 1) == 0) return null;
+        return m_arToGeoLocation[0].ToLocation();
+    }
+
+    private float[] m_arToGeoPoints = new float[0];
+
+#if UNITY_IOS
+    [DllImport("__Internal")] private static extern int indooratlas_arToGeoMany(float[] points, int count, [Out] LocationData[] locations);
+#endif
+    // Batched version of ArToGeo, converts count = min(points.Length, locations.Length) points in Unity world coordinates
+    // with a single native call and returns the number of points converted. Locations of points that could not be
+    // converted are zeroed, check for timestamp 0.
+    public int ArToGeoMany(Vector3[] points, LocationData[] locations) {
+        return ArToGeoMany(points, locations, Math.Min(points.Length, locations.Length));
+    }
+
+    // Batched version of ArToGeo for the first count elements of the arrays.
+    public int ArToGeoMany(Vector3[] points, LocationData[] locations, int count) {
+        using (s_arToGeoMarker.Auto()) {
+            if (count <= 0) return 0;
 #if UNITY_IOS
-        string data = indooratlas_arToGeo(c.x, c.y, c.z);
+            if (m_arToGeoPoints.Length < count * 3) m_arToGeoPoints = new float[count * 3];
+            for (int i = 0; i < count; ++i) {
+                Vector3 c = m_unityWorldToIndoorAtlasWorld.MultiplyPoint3x4(points[i]);
+                m_arToGeoPoints[i * 3] = c.x;
+                m_arToGeoPoints[i * 3 + 1] = c.y;
+                m_arToGeoPoints[i * 3 + 2] = c.z;
+            }
+            return indooratlas_arToGeoMany(m_arToGeoPoints, count, locations);
 #elif UNITY_ANDROID
-        string data = jPlugin.Call<string>("arToGeo", c.x, c.y, c.z);
+            IntPtr buffer = GetArToGeoBuffer(count);
+            for (int i = 0; i < count; ++i) {
+                Vector3 c = m_unityWorldToIndoorAtlasWorld.MultiplyPoint3x4(points[i]);
+                int o = i * ArToGeoRecordSize;
+                Marshal.WriteInt64(buffer, o, BitConverter.DoubleToInt64Bits(c.x));
+                Marshal.WriteInt64(buffer, o + 8, BitConverter.DoubleToInt64Bits(c.y));
+                Marshal.WriteInt64(buffer, o + 16, BitConverter.DoubleToInt64Bits(c.z));
+            }
+            jArToGeoArgs[0].i = count;
+            int converted = AndroidJNI.CallIntMethod(jPlugin.GetRawObject(), jArToGeoManyMethod, jArToGeoArgs);
+            for (int i = 0; i < count; ++i) {
+                int o = i * ArToGeoRecordSize;
+                locations[i] = new LocationData {
+                    latitude = ReadDouble(buffer, o), longitude = ReadDouble(buffer, o + 8), altitude = ReadDouble(buffer, o + 16),
+                    timestamp = Marshal.ReadInt64(buffer, o + 24), accuracy = (float)ReadDouble(buffer, o + 32),
+                    bearing = (float)ReadDouble(buffer, o + 40), floor = Marshal.ReadInt32(buffer, o + 48),
+                };
+            }
+            return converted;
+#else
+            for (int i = 0; i < count; ++i) locations[i] = new LocationData();
+            return 0;
 #endif
-        return (data != "" ? JsonUtility.FromJson<Location>(data) : null);
+        }
+    }
+
+#if UNITY_ANDROID
+    // Record size of Plugin.getArToGeoBuffer
+    private const int ArToGeoRecordSize = 56;
+    // Record size of Plugin.getGeoToArBuffer
+    private const int GeoToArRecordSize = 64;
+
+    static double ReadDouble(IntPtr ptr, int offset) {
+        return BitConverter.Int64BitsToDouble(Marshal.ReadInt64(ptr, offset));
     }
 
+    // Returns address of the direct buffer exchanging points and locations with arToGeoManyInBuffer, grown to capacity records
+    static IntPtr GetArToGeoBuffer(int capacity) {
+        if (capacity <= jArToGeoCapacity) return jArToGeoBufferAddress;
+        jArToGeoArgs[0].i = Math.Max(capacity, 2 * jArToGeoCapacity);
+        if (jArToGeoManyMethod == IntPtr.Zero) {
+            IntPtr c = jPlugin.GetRawClass();
+            jGetArToGeoBufferMethod = AndroidJNIHelper.GetMethodID(c, "getArToGeoBuffer", "(I)Ljava/nio/ByteBuffer;");
+            jArToGeoManyMethod = AndroidJNIHelper.GetMethodID(c, "arToGeoManyInBuffer", "(I)I");
+        }
+        IntPtr buffer = AndroidJNI.CallObjectMethod(jPlugin.GetRawObject(), jGetArToGeoBufferMethod, jArToGeoArgs);
+        jArToGeoBufferAddress = AndroidJNI.GetDirectBufferAddress(buffer);
+        AndroidJNI.DeleteLocalRef(buffer);
+        jArToGeoCapacity = jArToGeoArgs[0].i;
+        return jArToGeoBufferAddress;
+    }
+
+    // Returns address of the direct buffer passing planes to addArPlanesFromBuffer, grown to capacity planes
+    static IntPtr GetArPlaneBuffer(int capacity) {
+        if (capacity <= jArPlaneCapacity) return jArPlaneBufferAddress;
+        jArPlaneArgs[0].i = Math.Max(capacity, 2 * jArPlaneCapacity);
+        if (jAddArPlanesMethod == IntPtr.Zero) {
+            IntPtr c = jPlugin.GetRawClass();
+            jGetArPlaneBufferMethod = AndroidJNIHelper.GetMethodID(c, "getArPlaneBuffer", "(I)Ljava/nio/ByteBuffer;");
+            jAddArPlanesMethod = AndroidJNIHelper.GetMethodID(c, "addArPlanesFromBuffer", "(I)V");
+        }
+        IntPtr buffer = AndroidJNI.CallObjectMethod(jPlugin.GetRawObject(), jGetArPlaneBufferMethod, jArPlaneArgs);
+        jArPlaneBufferAddress = AndroidJNI.GetDirectBufferAddress(buffer);
+        AndroidJNI.DeleteLocalRef(buffer);
+        jArPlaneCapacity = jArPlaneArgs[0].i;
+        return jArPlaneBufferAddress;
+    }
+
+    // Returns address of the direct buffer exchanging coordinates and matrices with geoToArManyInBuffer, grown to capacity records
+    static IntPtr GetGeoToArBuffer(int capacity) {
+        if (capacity <= jGeoToArCapacity) return jGeoToArBufferAddress;
+        jGeoToArManyArgs[0].i = Math.Max(capacity, 2 * jGeoToArCapacity);
+        if (jGeoToArManyMethod == IntPtr.Zero) {
+            IntPtr c = jPlugin.GetRawClass();
+            jGetGeoToArBufferMethod = AndroidJNIHelper.GetMethodID(c, "getGeoToArBuffer", "(I)Ljava/nio/ByteBuffer;");
+            jGeoToArManyMethod = AndroidJNIHelper.GetMethodID(c, "geoToArManyInBuffer", "(IFF)I");
+        }
+        IntPtr buffer = AndroidJNI.CallObjectMethod(jPlugin.GetRawObject(), jGetGeoToArBufferMethod, jGeoToArManyArgs);
+        jGeoToArBufferAddress = AndroidJNI.GetDirectBufferAddress(buffer);
+        AndroidJNI.DeleteLocalRef(buffer);
+        jGeoToArCapacity = jGeoToArManyArgs[0].i;
+        return jGeoToArBufferAddress;
+    }
+#endif
+
 #if UNITY_IOS
     [DllImport("__Internal")] private static extern void indooratlas_setLocation(string location);
 #endif
@@ -0,0 +1,217 @@
+using System;
+using System.Collections;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Text;
+using UnityEngine;
+
+namespace IndoorAtlas {
+/// <summary>
+/// Measures the cost of the <c>LocationManager</c> bridge calls, of the native serializers producing the JSON
+/// callbacks and of parsing them, reporting calls per second, p50 and p99 latency and bytes allocated per call.
+/// Add next to an enabled <c>IndoorAtlasSession</c> (which may replay a trace, see <c>IndoorAtlasReplay</c>).
+/// Standalone and headless builds run it when started with <c>-indooratlas-benchmark [results.csv]</c>,
+/// and quit once done so that it can be run on a build machine. <c>-indooratlas-benchmark-baseline baseline.csv</c>
+/// logs the change of each case relative to a previous run, such as <c>Benchmarks/replay-baseline.csv</c>.
+/// </summary>
+[AddComponentMenu("IndoorAtlas/IndoorAtlas Benchmark")]
+public class IndoorAtlasBenchmark : MonoBehaviour {
+    /// <summary>
+    /// Result of a single benchmark case.
+    /// </summary>
+    public struct Result {
+        public string name;
+        public int calls;
+        public double callsPerSecond;
+        // Latencies in microseconds
+        public double p50, p99;
+        // Managed bytes, the native serializers allocate none
+        public double bytesPerCall;
+
+        public override string ToString() {
+            return string.Format(CultureInfo.InvariantCulture, "{0}: {1:F0} calls/s, p50 {2:F2} us, p99 {3:F2} us, {4:F1} B/call",
+                    name, callsPerSecond, p50, p99, bytesPerCall);
+        }
+    }
+
+    [SerializeField]
+    [Tooltip("Number of measured calls per benchmark case.")]
+    int m_iterations = 1000;
+
+    public int iterations
+    {
+        get { return m_iterations; }
+        set { m_iterations = value; }
+    }
+
+    [SerializeField]
+    [Tooltip("Run the benchmark when the component starts.")]
+    bool m_runOnStart = false;
+
+    readonly List<Result> m_results = new List<Result>();
+    string m_output = null;
+    string m_baseline = null;
+    bool m_quit = false;
+
+    /// <summary>
+    /// Results of the latest run.
+    /// </summary>
+    public List<Result> results
+    {
+        get { return m_results; }
+    }
+
+    // Payloads in the same format as sent by the native side
+    const string LocationJson = "{\"accuracy\":3.5,\"altitude\":12.0,\"bearing\":90.0,\"position\":{\"coordinate\":{\"latitude\":60.1699,\"longitude\":24.9384},\"floor\":2},\"timestamp\":1700000000000}";
+    const string HeadingJson = "{\"heading\":123.4,\"timestamp\":1700000000000}";
+    const string OrientationJson = "{\"x\":0.1,\"y\":0.2,\"z\":0.3,\"w\":0.9,\"timestamp\":1700000000000}";
+
+    void Start() {
+        string[] args = Environment.GetCommandLineArgs();
+        for (int i = 0; i < args.Length; ++i) {
+            if (args[i] != "-indooratlas-benchmark") continue;
+            m_runOnStart = m_quit = true;
+            if (i + 1 < args.Length && !args[i + 1].StartsWith("-")) m_output = args[i + 1];
+        }
+        for (int i = 0; i + 1 < args.Length; ++i) {
+            if (args[i] == "-indooratlas-benchmark-baseline") m_baseline = args[i + 1];
+        }
+        if (m_runOnStart) StartCoroutine(Run());
+    }
+
+    Result Measure(string name, Action call) {
+        call(); // warm up, so that JIT and first-call allocations are not measured
+        long[] ticks = new long[m_iterations];
+        Stopwatch watch = new Stopwatch();
+        long allocated = GC.GetAllocatedBytesForCurrentThread();
+        long start = Stopwatch.GetTimestamp();
+        for (int i = 0; i < m_iterations; ++i) {
+            watch.Restart();
+            call();
+            ticks[i] = watch.ElapsedTicks;
+        }
+        long total = Stopwatch.GetTimestamp() - start;
+        allocated = GC.GetAllocatedBytesForCurrentThread() - allocated;
+        Array.Sort(ticks);
+        double us = 1e6 / Stopwatch.Frequency;
+        return new Result {
+            name = name,
+            calls = m_iterations,
+            callsPerSecond = m_iterations / Math.Max(total / (double)Stopwatch.Frequency, 1e-9),
+            p50 = ticks[m_iterations / 2] * us,
+            p99 = ticks[Math.Min(m_iterations - 1, m_iterations * 99 / 100)] * us,
+            bytesPerCall = allocated / (double)m_iterations,
+        };
+    }
+
+    // Summarizes durations measured on the native side, which are timed there to leave out the bridge call
+    static Result Summarize(string name, double[] microseconds, int count) {
+        Array.Sort(microseconds, 0, count);
+        double total = 0;
+        for (int i = 0; i < count; ++i) total += microseconds[i];
+        return new Result {
+            name = name,
+            calls = count,
+            callsPerSecond = count / Math.Max(total * 1e-6, 1e-9),
+            p50 = microseconds[count / 2],
+            p99 = microseconds[Math.Min(count - 1, count * 99 / 100)],
+            bytesPerCall = 0,
+        };
+    }
+
+    /// <summary>
+    /// Runs all benchmark cases, one per frame, and logs the results.
+    /// </summary>
+    public IEnumerator Run() {
+        m_results.Clear();
+        LocationManager manager = new LocationManager();
+        ArFrame frame = new ArFrame();
+        const int anchors = 32;
+        double[] lat = new double[anchors], lon = new double[anchors];
+        int[] floor = new int[anchors];
+        Matrix4x4[] matrices = new Matrix4x4[anchors];
+        Vector3[] points = new Vector3[anchors];
+        LocationData[] locations = new LocationData[anchors];
+        for (int i = 0; i < anchors; ++i) { lat[i] = 60.1699 + i * 1e-5; lon[i] = 24.9384; floor[i] = 2; points[i] = new Vector3(i, 0, i); }
+        float[] planes = new float[16 * LocationManager.ArPlaneStride];
+        Matrix4x4 pose = Matrix4x4.TRS(new Vector3(1, 2, 3), Quaternion.Euler(10, 20, 30), Vector3.one);
+
+        var cases = new List<KeyValuePair<string, Action>> {
+            new KeyValuePair<string, Action>("GetArFrame", () => manager.GetArFrame(frame)),
+            new KeyValuePair<string, Action>("GetArCompassMatrix", () => manager.GetArCompassMatrix()),
+            new KeyValuePair<string, Action>("GeoToAr", () => manager.GeoToAr(lat[0], lon[0], floor[0], 0, 0)),
+            new KeyValuePair<string, Action>("GeoToArMany(32)", () => manager.GeoToArMany(lat, lon, floor, matrices)),
+            new KeyValuePair<string, Action>("ArToGeo", () => manager.ArToGeo(1, 2, 3)),
+            new KeyValuePair<string, Action>("ArToGeoMany(32)", () => manager.ArToGeoMany(points, locations)),
+            new KeyValuePair<string, Action>("SetArPoseMatrix", () => manager.SetArPoseMatrix(pose)),
+            new KeyValuePair<string, Action>("SetArCameraToWorldMatrix", () => manager.SetArCameraToWorldMatrix(pose)),
+            new KeyValuePair<string, Action>("AddArPlanes(16)", () => manager.AddArPlanes(planes, 16)),
+            new KeyValuePair<string, Action>("Json Location", () => JsonUtility.FromJson<Location>(LocationJson)),
+            new KeyValuePair<string, Action>("Json Heading", () => JsonUtility.FromJson<Heading>(HeadingJson)),
+            new KeyValuePair<string, Action>("Json Orientation", () => JsonUtility.FromJson<Orientation>(OrientationJson)),
+        };
+
+        foreach (var c in cases) {
+            yield return null;
+            Result result = Measure(c.Key, c.Value);
+            m_results.Add(result);
+            UnityEngine.Debug.Log("IndoorAtlas benchmark: " + result);
+        }
+
+        // The region serializers need a region entered during this session, they are skipped until there is one
+        var serializers = new List<KeyValuePair<string, LocationManager.Serializer>> {
+            new KeyValuePair<string, LocationManager.Serializer>("Serialize Location", LocationManager.Serializer.Location),
+            new KeyValuePair<string, LocationManager.Serializer>("Serialize Region with venue", LocationManager.Serializer.RegionWithVenue),
+            new KeyValuePair<string, LocationManager.Serializer>("Serialize Region", LocationManager.Serializer.Region),
+        };
+        double[] microseconds = new double[m_iterations];
+        foreach (var s in serializers) {
+            yield return null;
+            int count = manager.BenchmarkSerializer(s.Value, microseconds);
+            if (count == 0) continue;
+            Result result = Summarize(s.Key, microseconds, count);
+            m_results.Add(result);
+            UnityEngine.Debug.Log("IndoorAtlas benchmark: " + result);
+        }
+
+        if (!string.IsNullOrEmpty(m_baseline)) CompareCsv(m_baseline);
+        if (!string.IsNullOrEmpty(m_output)) WriteCsv(m_output);
+        if (m_quit) Application.Quit(0);
+    }
+
+    /// <summary>
+    /// Writes the results of the latest run as CSV.
+    /// </summary>
+    public void WriteCsv(string path) {
+        var csv = new StringBuilder("name,calls,calls_per_second,p50_us,p99_us,bytes_per_call\n");
+        foreach (Result r in m_results) {
+            csv.AppendFormat(CultureInfo.InvariantCulture, "{0},{1},{2:F0},{3:F3},{4:F3},{5:F1}\n",
+                    r.name, r.calls, r.callsPerSecond, r.p50, r.p99, r.bytesPerCall);
+        }
+        File.WriteAllText(path, csv.ToString());
+    }
+
+    /// <summary>
+    /// Logs the p50 latency of each case of the latest run relative to the same case in a CSV written by <c>WriteCsv</c>.
+    /// Cases missing from the baseline are skipped.
+    /// </summary>
+    public void CompareCsv(string path) {
+        var baseline = new Dictionary<string, double>();
+        string[] lines = File.ReadAllLines(path);
+        for (int i = 1; i < lines.Length; ++i) {
+            string[] fields = lines[i].Split(',');
+            double p50;
+            if (fields.Length < 6 || !double.TryParse(fields[3], NumberStyles.Float, CultureInfo.InvariantCulture, out p50)) continue;
+            baseline[fields[0]] = p50;
+        }
+        foreach (Result r in m_results) {
+            double p50;
+            if (!baseline.TryGetValue(r.name, out p50) || p50 <= 0) continue;
+            UnityEngine.Debug.Log(string.Format(CultureInfo.InvariantCulture, "IndoorAtlas benchmark: {0}: p50 {1:F2} us, {2:+0.0;-0.0}% from baseline",
+                    r.name, r.p50, 100.0 * (r.p50 / p50 - 1.0)));
+        }
+    }
+}
+}
@@ -0,0 +1,233 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Threading;
+
+namespace IndoorAtlas {
+
+// How high-rate events (location, heading, orientation and status) are delivered from the native SDK.
+public enum EventTransport : int {
+    // Events are serialized to JSON and delivered with UnitySendMessage.
+    Json = 0,
+    // Events are written to a fixed-layout buffer shared with the native side and
+    // drained once per frame by IndoorAtlasSession without string or object allocations.
+    Binary = 1,
+};
+
+public enum EventType : int {
+    None = 0,
+    Location = 1,
+    Heading = 2,
+    Orientation = 3,
+    Status = 4,
+};
+
+[Flags]
+public enum EventTypeMask : int {
+    None = 0,
+    Location = 1 << EventType.Location,
+    Heading = 1 << EventType.Heading,
+    Orientation = 1 << EventType.Orientation,
+    Status = 1 << EventType.Status,
+};
+
+// Fixed-layout event record as written by the native side.
+// Interpretation of values depends on type:
+//   Location:    latitude, longitude, accuracy, altitude, bearing
+//   Heading:     heading
+//   Orientation: x, y, z, w
+//   Status:      code is the Status.ServiceStatus
+public struct EventRecord {
+    public EventType type;
+    // UTC time of the event in milliseconds.
+    public long timestamp;
+    public int floor;
+    public int code;
+    public double v0, v1, v2, v3, v4;
+}
+
+// Reader for the event buffer shared with the native plugin.
+// The layout must be kept in sync with NativeBridge.m and EventBuffer.java:
+//
+//   Header (64 bytes):
+//     0  int32 head, number of records pushed to the ring (written by native side)
+//     4  int32 tail, number of records consumed from the ring (written by C# side)
+//     8  int32 ring capacity in records
+//     12 int32 keep latest mask, bit (1 << type) set if only the latest event of the type is kept (written by C# side)
+//     16 int32 dropped[8], events dropped because the ring was full (written by native side)
+//     48 int32 AR alignment version, incremented whenever the geo to AR alignment changes (written by native side)
+//   Latest slots (MaxTypes records), slot index is the event type
+//   Ring (capacity records)
+//
+//   Record (64 bytes):
+//     0  int32  sequence (odd while the native side is writing a latest slot, unused in the ring)
+//     4  int32  type
+//     8  int64  timestamp
+//     16 int32  floor
+//     20 int32  code
+//     24 double values[5]
+//
+// Single producer (the native SDK callback thread), single consumer (Unity main thread).
+// Events whose type is in the keep latest mask bypass the ring and overwrite their latest slot,
+// which is guarded by a sequence lock, so a burst of them never fills the ring.
+internal class EventBuffer {
+    public const int HeaderSize = 64;
+    public const int RecordSize = 64;
+    public const int MaxTypes = 8;
+
+    const int HeadOffset = 0;
+    const int TailOffset = 4;
+    const int CapacityOffset = 8;
+    const int KeepLatestOffset = 12;
+    const int DroppedOffset = 16;
+    const int ArAlignmentOffset = 48;
+
+    readonly IntPtr m_buffer;
+    readonly IntPtr m_slots;
+    readonly IntPtr m_ring;
+    readonly int m_capacity;
+    readonly int[] m_lastSequence = new int[MaxTypes];
+    readonly int[] m_coalesced = new int[MaxTypes];
+    readonly int[] m_droppedBefore = new int[MaxTypes];
+
+    // The native buffer may outlive a session (it is process global on iOS), so whatever the previous
+    // session left in it is skipped: queued records, latest slots and dropped counts start from here.
+    public EventBuffer(IntPtr buffer) {
+        m_buffer = buffer;
+        m_capacity = Marshal.ReadInt32(buffer, CapacityOffset);
+        m_slots = IntPtr.Add(buffer, HeaderSize);
+        m_ring = IntPtr.Add(m_slots, MaxTypes * RecordSize);
+        Consume(Pending());
+        for (int type = 0; type < MaxTypes; ++type) {
+            // an odd sequence is a write in progress, it is treated as new once it completes
+            m_lastSequence[type] = Marshal.ReadInt32(IntPtr.Add(m_slots, type * RecordSize), 0) & ~1;
+            m_droppedBefore[type] = Marshal.ReadInt32(buffer, DroppedOffset + type * 4);
+        }
+    }
+
+    public EventTypeMask keepLatest {
+        get { return (EventTypeMask)Marshal.ReadInt32(m_buffer, KeepLatestOffset); }
+        set { Marshal.WriteInt32(m_buffer, KeepLatestOffset, (int)value); }
+    }
+
+    // Number of events of the given type that were never dispatched, either because
+    // the ring was full or because a newer event replaced them in their latest slot.
+    public int GetDroppedCount(EventType type) {
+        return Marshal.ReadInt32(m_buffer, DroppedOffset + (int)type * 4) - m_droppedBefore[(int)type] + m_coalesced[(int)type];
+    }
+
+    // Reads the AR alignment version from the header of the buffer at address
+    public static int ReadArAlignment(IntPtr buffer) {
+        return Marshal.ReadInt32(buffer, ArAlignmentOffset);
+    }
+
+    // Allocates zeroed buffer with the native layout for capacity ring records, capacity must be power of two.
+    // Used by the managed replay backend, free with Marshal.FreeHGlobal.
+    public static IntPtr Allocate(int capacity) {
+        int size = HeaderSize + (MaxTypes + capacity) * RecordSize;
+        IntPtr buffer = Marshal.AllocHGlobal(size);
+        for (int i = 0; i < size; i += 4) Marshal.WriteInt32(buffer, i, 0);
+        Marshal.WriteInt32(buffer, CapacityOffset, capacity);
+        return buffer;
+    }
+
+    static double ReadDouble(IntPtr ptr, int offset) {
+        return BitConverter.Int64BitsToDouble(Marshal.ReadInt64(ptr, offset));
+    }
+
+    static void ReadRecord(IntPtr ptr, ref EventRecord record) {
+        record.type = (EventType)Marshal.ReadInt32(ptr, 4);
+        record.timestamp = Marshal.ReadInt64(ptr, 8);
+        record.floor = Marshal.ReadInt32(ptr, 16);
+        record.code = Marshal.ReadInt32(ptr, 20);
+        record.v0 = ReadDouble(ptr, 24);
+        record.v1 = ReadDouble(ptr, 32);
+        record.v2 = ReadDouble(ptr, 40);
+        record.v3 = ReadDouble(ptr, 48);
+        record.v4 = ReadDouble(ptr, 56);
+    }
+
+    static void WriteRecord(IntPtr ptr, ref EventRecord record) {
+        Marshal.WriteInt32(ptr, 4, (int)record.type);
+        Marshal.WriteInt64(ptr, 8, record.timestamp);
+        Marshal.WriteInt32(ptr, 16, record.floor);
+        Marshal.WriteInt32(ptr, 20, record.code);
+        Marshal.WriteInt64(ptr, 24, BitConverter.DoubleToInt64Bits(record.v0));
+        Marshal.WriteInt64(ptr, 32, BitConverter.DoubleToInt64Bits(record.v1));
+        Marshal.WriteInt64(ptr, 40, BitConverter.DoubleToInt64Bits(record.v2));
+        Marshal.WriteInt64(ptr, 48, BitConverter.DoubleToInt64Bits(record.v3));
+        Marshal.WriteInt64(ptr, 56, BitConverter.DoubleToInt64Bits(record.v4));
+    }
+
+    // Producer side, same logic as event_push in NativeBridge.m.
+    // Only used by the managed replay backend, which pushes from the Unity main thread.
+    public void Push(ref EventRecord record) {
+        int type = (int)record.type;
+        if (((int)keepLatest & (1 << type)) != 0) {
+            IntPtr slot = IntPtr.Add(m_slots, type * RecordSize);
+            int sequence = Marshal.ReadInt32(slot, 0);
+            Marshal.WriteInt32(slot, 0, sequence + 1);
+            Thread.MemoryBarrier();
+            WriteRecord(slot, ref record);
+            Thread.MemoryBarrier();
+            Marshal.WriteInt32(slot, 0, sequence + 2);
+            return;
+        }
+
+        int head = Marshal.ReadInt32(m_buffer, HeadOffset);
+        int tail = Marshal.ReadInt32(m_buffer, TailOffset);
+        Thread.MemoryBarrier();
+        if (head - tail >= m_capacity) {
+            int dropped = DroppedOffset + type * 4;
+            Marshal.WriteInt32(m_buffer, dropped, Marshal.ReadInt32(m_buffer, dropped) + 1);
+            return;
+        }
+        WriteRecord(IntPtr.Add(m_ring, (int)((uint)head % (uint)m_capacity) * RecordSize), ref record);
+        Thread.MemoryBarrier();
+        Marshal.WriteInt32(m_buffer, HeadOffset, head + 1);
+    }
+
+    // Reads the latest slot of the given type into record.
+    // Returns false if there is no new event since the previous call.
+    public bool ReadLatest(EventType type, ref EventRecord record) {
+        int slot = (int)type;
+        IntPtr ptr = IntPtr.Add(m_slots, slot * RecordSize);
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            int sequence = Marshal.ReadInt32(ptr, 0);
+            if (sequence == m_lastSequence[slot]) return false;
+            if ((sequence & 1) != 0) continue; // writer is in the middle of an update
+            Thread.MemoryBarrier();
+            ReadRecord(ptr, ref record);
+            Thread.MemoryBarrier();
+            if (Marshal.ReadInt32(ptr, 0) != sequence) continue; // torn read, try again
+            // Sequence advances by two for every write
+            m_coalesced[slot] += Math.Max(0, (sequence - m_lastSequence[slot]) / 2 - 1);
+            m_lastSequence[slot] = sequence;
+            return true;
+        }
+        return false;
+    }
+
+    // Returns number of records waiting in the ring.
+    // Records are read with ReadQueued and released with Consume.
+    public int Pending() {
+        int pending = Marshal.ReadInt32(m_buffer, HeadOffset) - Marshal.ReadInt32(m_buffer, TailOffset);
+        Thread.MemoryBarrier();
+        return pending;
+    }
+
+    // Reads the index'th pending record of the ring, index must be less than Pending().
+    public void ReadQueued(int index, ref EventRecord record) {
+        int tail = Marshal.ReadInt32(m_buffer, TailOffset);
+        int slot = (int)((uint)(tail + index) % (uint)m_capacity);
+        ReadRecord(IntPtr.Add(m_ring, slot * RecordSize), ref record);
+    }
+
+    // Releases count records back to the producer.
+    public void Consume(int count) {
+        int tail = Marshal.ReadInt32(m_buffer, TailOffset);
+        Thread.MemoryBarrier();
+        Marshal.WriteInt32(m_buffer, TailOffset, tail + count);
+    }
+}
+
+}
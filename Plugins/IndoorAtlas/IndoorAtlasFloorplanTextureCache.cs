@@ -0,0 +1,579 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.Compression;
+using System.Threading;
+using UnityEngine;
+using UnityEngine.Networking;
+
+namespace IndoorAtlas {
+
+/// <summary>
+/// Fetches the encoded image of a floor plan for <c>FloorplanTextureCache</c>.
+/// </summary>
+public interface IFloorplanImageSource {
+    /// <summary>
+    /// Starts fetching the image of plan. done must be called on the main thread, with the encoded image
+    /// and null, or with null and an error message.
+    /// </summary>
+    void Fetch(Floorplan plan, Action<byte[], string> done);
+}
+
+/// <summary>
+/// Fetches floor plan images from <c>Floorplan.imageUrl</c> with <c>UnityWebRequest</c>, which also
+/// handles <c>file://</c> URLs for local stand-ins.
+/// </summary>
+public class WebFloorplanImageSource : IFloorplanImageSource {
+    public void Fetch(Floorplan plan, Action<byte[], string> done) {
+        UnityWebRequest request = UnityWebRequest.Get(plan.imageUrl);
+        request.SendWebRequest().completed += (op) => {
+            if (request.result == UnityWebRequest.Result.Success) done(request.downloadHandler.data, null);
+            else done(null, request.error);
+            request.Dispose();
+        };
+    }
+}
+
+/// <summary>
+/// Texture of a floor plan and where to place it.
+/// </summary>
+public class FloorplanTexture {
+    /// <summary>
+    /// The floor plan the texture was loaded for.
+    /// </summary>
+    public Floorplan floorplan { get; internal set; }
+
+    /// <summary>
+    /// Mipmapped, non-readable texture of the floor plan image, owned by the cache.
+    /// </summary>
+    public Texture2D texture { get; internal set; }
+
+    /// <summary>
+    /// Transform of a Unity Quad primitive that covers the floor plan in meters: centered at the origin,
+    /// lying on the XZ plane facing up, with the top edge of the image towards +Z.
+    /// Combine it with the geo-alignment of your scene to place the plan in the world.
+    /// </summary>
+    public Matrix4x4 placement { get; internal set; }
+
+    /// <summary>
+    /// Converts pixel coordinates of the image (origin at the top left corner, y down) to meters on the plane of <c>placement</c>.
+    /// </summary>
+    public Vector3 PixelToLocal(float x, float y) {
+        float scale = floorplan.pixelToMeterConversion;
+        return new Vector3((x - floorplan.width * 0.5f) * scale, 0, (floorplan.height * 0.5f - y) * scale);
+    }
+}
+
+/// <summary>
+/// Loads floor plan images as textures, keyed by <c>Floorplan.id</c>.
+/// Encoded images are fetched through an <c>IFloorplanImageSource</c> and kept in a disk cache bounded by
+/// <c>diskBudget</c> bytes, evicting the least recently used images first. PNG images are decoded and their
+/// mipmaps generated on a background thread, so the main thread only uploads the finished mip chain; other
+/// formats are decoded on the main thread by Unity. The latest <c>maxTextures</c> textures stay in memory,
+/// so revisiting a floor costs neither network nor decoding.
+/// Create and use the cache on the main thread.
+/// </summary>
+public class FloorplanTextureCache : IDisposable {
+    class Entry {
+        public string key;
+        public FloorplanTexture texture;
+        public List<Action<FloorplanTexture>> callbacks;
+    }
+
+    // Result of the background thread, pixels is null if the image has to be decoded by Unity
+    struct Decoded {
+        public byte[] pixels;
+        public int width, height;
+        public byte[] encoded;
+    }
+
+    struct CachedFile {
+        public string path;
+        public long size;
+        public DateTime used;
+    }
+
+    readonly IFloorplanImageSource m_source;
+    readonly string m_directory;
+    readonly long m_diskBudget;
+    readonly int m_maxTextures;
+    readonly int m_maxTextureSize;
+    readonly SynchronizationContext m_mainThread;
+    // Loaded and loading floor plans by id, most recently used last
+    readonly Dictionary<string, Entry> m_entries = new Dictionary<string, Entry>();
+    readonly LinkedList<string> m_recent = new LinkedList<string>();
+
+    readonly object m_lock = new object();
+    readonly Queue<Action> m_jobs = new Queue<Action>();
+    readonly Thread m_thread;
+    bool m_stop = false;
+    const string TempSuffix = ".tmp";
+    // Disk cache index, only touched by the background thread
+    List<CachedFile> m_files = null;
+    long m_diskUsed = 0;
+
+    /// <summary>
+    /// Creates cache.
+    /// </summary>
+    /// <param name="source">Image source, <c>WebFloorplanImageSource</c> if null</param>
+    /// <param name="directory">Disk cache directory, a directory under <c>Application.temporaryCachePath</c> if null</param>
+    /// <param name="diskBudget">Maximum size of the disk cache in bytes</param>
+    /// <param name="maxTextures">Number of textures kept in memory</param>
+    /// <param name="maxTextureSize">Larger images are downscaled to at most this many pixels wide and high</param>
+    public FloorplanTextureCache(IFloorplanImageSource source = null, string directory = null,
+            long diskBudget = 64L * 1024 * 1024, int maxTextures = 4, int maxTextureSize = 4096) {
+        m_source = source ?? new WebFloorplanImageSource();
+        m_directory = directory ?? Path.Combine(Application.temporaryCachePath, "IndoorAtlas/floorplans");
+        m_diskBudget = diskBudget;
+        m_maxTextures = Math.Max(1, maxTextures);
+        m_maxTextureSize = maxTextureSize;
+        m_mainThread = SynchronizationContext.Current;
+        m_thread = new Thread(Run) { Name = "IndoorAtlas floor plans", IsBackground = true };
+        m_thread.Start();
+    }
+
+    /// <summary>
+    /// Number of bytes in the disk cache, as of the latest disk operation.
+    /// </summary>
+    public long diskUsed {
+        get { return Interlocked.Read(ref m_diskUsed); }
+    }
+
+    /// <summary>
+    /// Returns the loaded texture of the floor plan, or null if it is not in memory.
+    /// </summary>
+    public FloorplanTexture Get(Floorplan plan) {
+        Entry entry;
+        if (!m_entries.TryGetValue(plan.id, out entry) || entry.key != Key(plan)) return null;
+        return entry.texture;
+    }
+
+    /// <summary>
+    /// Loads the texture of the floor plan and calls done with it on the main thread, or with null if it failed.
+    /// done is called before this returns if the texture is already in memory.
+    /// </summary>
+    public void Load(Floorplan plan, Action<FloorplanTexture> done) {
+        string key = Key(plan);
+        Entry entry;
+        if (m_entries.TryGetValue(plan.id, out entry) && entry.key == key) {
+            Touch(plan.id);
+            if (entry.texture != null) done(entry.texture);
+            else entry.callbacks.Add(done);
+            return;
+        }
+        if (entry != null) Remove(plan.id); // the image of the floor plan changed
+        entry = new Entry { key = key, callbacks = new List<Action<FloorplanTexture>> { done } };
+        m_entries.Add(plan.id, entry);
+        m_recent.AddLast(plan.id);
+        EnqueueLoad(plan, key, () => {
+            byte[] encoded = ReadCached(key);
+            if (encoded == null) {
+                Post(() => m_source.Fetch(plan, (bytes, error) => OnFetched(plan, key, bytes, error)));
+                return;
+            }
+            Decoded decoded = Decode(encoded);
+            Post(() => Upload(plan, key, decoded));
+        });
+    }
+
+    void OnFetched(Floorplan plan, string key, byte[] encoded, string error) {
+        if (encoded == null) {
+            Debug.LogWarning("IndoorAtlas: failed to fetch floor plan " + plan.id + ": " + error);
+            Upload(plan, key, new Decoded());
+            return;
+        }
+        EnqueueLoad(plan, key, () => {
+            WriteCached(key, encoded);
+            Decoded decoded = Decode(encoded);
+            Post(() => Upload(plan, key, decoded));
+        });
+    }
+
+    // Runs on the main thread
+    void Upload(Floorplan plan, string key, Decoded decoded) {
+        Entry entry;
+        if (!m_entries.TryGetValue(plan.id, out entry) || entry.key != key) return; // removed meanwhile
+        Texture2D texture = null;
+        if (decoded.pixels != null) {
+            texture = new Texture2D(decoded.width, decoded.height, TextureFormat.RGBA32, true);
+            texture.LoadRawTextureData(decoded.pixels);
+            texture.Apply(false, true);
+        } else if (decoded.encoded != null) {
+            texture = new Texture2D(2, 2, TextureFormat.RGBA32, true);
+            if (ImageConversion.LoadImage(texture, decoded.encoded, false)) {
+                texture.Apply(true, true);
+            } else {
+                Debug.LogWarning("IndoorAtlas: failed to decode floor plan " + plan.id);
+                UnityEngine.Object.Destroy(texture);
+                texture = null;
+                Enqueue(() => EvictCached(key)); // fetched again on the next Load
+            }
+        }
+
+        List<Action<FloorplanTexture>> callbacks = entry.callbacks;
+        entry.callbacks = null;
+        if (texture) {
+            texture.wrapMode = TextureWrapMode.Clamp;
+            texture.filterMode = FilterMode.Trilinear;
+            float width = (plan.widthMeters > 0 ? plan.widthMeters : plan.width * plan.pixelToMeterConversion);
+            float height = (plan.heightMeters > 0 ? plan.heightMeters : plan.height * plan.pixelToMeterConversion);
+            entry.texture = new FloorplanTexture {
+                floorplan = plan, texture = texture,
+                placement = Matrix4x4.TRS(Vector3.zero, Quaternion.Euler(90, 0, 0), new Vector3(width, height, 1)),
+            };
+            Trim();
+        } else {
+            Remove(plan.id); // retried on the next Load
+        }
+        foreach (var callback in callbacks) callback(entry.texture);
+    }
+
+    void Touch(string id) {
+        m_recent.Remove(id);
+        m_recent.AddLast(id);
+    }
+
+    void Remove(string id) {
+        Entry entry;
+        if (!m_entries.TryGetValue(id, out entry)) return;
+        if (entry.texture != null) UnityEngine.Object.Destroy(entry.texture.texture);
+        m_entries.Remove(id);
+        m_recent.Remove(id);
+    }
+
+    // Destroys the least recently used textures beyond maxTextures, loading ones are never evicted
+    void Trim() {
+        int loaded = 0;
+        foreach (Entry entry in m_entries.Values) if (entry.texture != null) ++loaded;
+        for (var node = m_recent.First; node != null && loaded > m_maxTextures;) {
+            var next = node.Next;
+            if (m_entries[node.Value].texture != null) {
+                Remove(node.Value);
+                --loaded;
+            }
+            node = next;
+        }
+    }
+
+    // Cache key, changes when the image URL of the floor plan does
+    static string Key(Floorplan plan) {
+        ulong hash = 0xcbf29ce484222325UL;
+        foreach (char c in plan.imageUrl ?? "") hash = (hash ^ c) * 0x100000001b3UL;
+        return plan.id + "-" + hash.ToString("x16");
+    }
+
+    void Post(Action action) {
+        if (m_mainThread != null) m_mainThread.Post((state) => { if (!m_stop) action(); }, null);
+        else Debug.LogError("IndoorAtlas: FloorplanTextureCache must be created on the main thread");
+    }
+
+    void Enqueue(Action job) {
+        lock (m_lock) {
+            m_jobs.Enqueue(job);
+            Monitor.Pulse(m_lock);
+        }
+    }
+
+    // Enqueues a job of loading the floor plan, if it throws the load completes with null instead of staying
+    // in progress forever and the cached image, which may be the cause, is evicted
+    void EnqueueLoad(Floorplan plan, string key, Action job) {
+        Enqueue(() => {
+            try {
+                job();
+            } catch (Exception e) {
+                Debug.LogException(e);
+                Post(() => Upload(plan, key, new Decoded()));
+                EvictCached(key);
+            }
+        });
+    }
+
+    void Run() {
+        for (;;) {
+            Action job;
+            lock (m_lock) {
+                while (m_jobs.Count == 0 && !m_stop) Monitor.Wait(m_lock);
+                if (m_stop) return;
+                job = m_jobs.Dequeue();
+            }
+            try {
+                job();
+            } catch (Exception e) {
+                Debug.LogException(e);
+            }
+        }
+    }
+
+    Decoded Decode(byte[] encoded) {
+        Decoded decoded = new Decoded { encoded = encoded };
+        int width, height;
+        byte[] pixels = PngDecoder.Decode(encoded, out width, out height);
+        if (pixels == null) return decoded;
+        decoded.pixels = BuildMipChain(pixels, ref width, ref height);
+        decoded.width = width;
+        decoded.height = height;
+        return decoded;
+    }
+
+    // Returns the RGBA32 mip chain in the layout of Texture2D.LoadRawTextureData, starting from the first
+    // level that fits in maxTextureSize, whose size is returned in width and height
+    byte[] BuildMipChain(byte[] level, ref int width, ref int height) {
+        var levels = new List<byte[]> { level };
+        int w = width, h = height, total = 0, first = 0;
+        while (w > 1 || h > 1) {
+            int nw = Math.Max(1, w / 2), nh = Math.Max(1, h / 2);
+            byte[] next = new byte[nw * nh * 4];
+            for (int y = 0; y < nh; ++y) {
+                int y0 = Math.Min(2 * y, h - 1) * w, y1 = Math.Min(2 * y + 1, h - 1) * w;
+                for (int x = 0; x < nw; ++x) {
+                    int x0 = Math.Min(2 * x, w - 1), x1 = Math.Min(2 * x + 1, w - 1);
+                    for (int c = 0; c < 4; ++c) {
+                        int sum = level[(y0 + x0) * 4 + c] + level[(y0 + x1) * 4 + c] + level[(y1 + x0) * 4 + c] + level[(y1 + x1) * 4 + c];
+                        next[(y * nw + x) * 4 + c] = (byte)((sum + 2) >> 2);
+                    }
+                }
+            }
+            if (Math.Max(w, h) > m_maxTextureSize) {
+                ++first;
+                width = nw;
+                height = nh;
+            }
+            levels.Add(level = next);
+            w = nw;
+            h = nh;
+        }
+        for (int i = first; i < levels.Count; ++i) total += levels[i].Length;
+        byte[] chain = new byte[total];
+        for (int i = first, offset = 0; i < levels.Count; offset += levels[i].Length, ++i) {
+            Buffer.BlockCopy(levels[i], 0, chain, offset, levels[i].Length);
+        }
+        return chain;
+    }
+
+    void ScanDisk() {
+        if (m_files != null) return;
+        m_files = new List<CachedFile>();
+        Directory.CreateDirectory(m_directory);
+        long used = 0;
+        foreach (string path in Directory.GetFiles(m_directory)) {
+            if (path.EndsWith(TempSuffix, StringComparison.Ordinal)) {
+                // left behind by a write that was interrupted
+                try {
+                    File.Delete(path);
+                } catch (IOException) {
+                }
+                continue;
+            }
+            var info = new FileInfo(path);
+            m_files.Add(new CachedFile { path = path, size = info.Length, used = info.LastWriteTimeUtc });
+            used += info.Length;
+        }
+        m_files.Sort((a, b) => a.used.CompareTo(b.used));
+        Interlocked.Exchange(ref m_diskUsed, used);
+    }
+
+    byte[] ReadCached(string key) {
+        ScanDisk();
+        string path = Path.Combine(m_directory, key);
+        int index = m_files.FindIndex((f) => f.path == path);
+        if (index < 0) return null;
+        byte[] data;
+        try {
+            data = File.ReadAllBytes(path);
+        } catch (IOException) {
+            return null;
+        }
+        // the write time doubles as the last use time of the LRU order
+        CachedFile file = m_files[index];
+        file.used = DateTime.UtcNow;
+        File.SetLastWriteTimeUtc(path, file.used);
+        m_files.RemoveAt(index);
+        m_files.Add(file);
+        return data;
+    }
+
+    void WriteCached(string key, byte[] data) {
+        ScanDisk();
+        if (data.Length > m_diskBudget) return;
+        string path = Path.Combine(m_directory, key);
+        long used = Interlocked.Read(ref m_diskUsed);
+        int index = m_files.FindIndex((f) => f.path == path);
+        if (index >= 0) {
+            used -= m_files[index].size;
+            m_files.RemoveAt(index);
+        }
+        while (m_files.Count > 0 && used + data.Length > m_diskBudget) {
+            try {
+                File.Delete(m_files[0].path);
+            } catch (IOException) {
+            }
+            used -= m_files[0].size;
+            m_files.RemoveAt(0);
+        }
+        // written to a temporary file first so that an interrupted write never leaves a truncated image behind
+        string temp = path + TempSuffix;
+        try {
+            File.WriteAllBytes(temp, data);
+            if (File.Exists(path)) File.Delete(path);
+            File.Move(temp, path);
+        } catch (IOException e) {
+            Debug.LogWarning("IndoorAtlas: failed to cache floor plan image: " + e.Message);
+            try {
+                File.Delete(temp);
+            } catch (IOException) {
+            }
+            Interlocked.Exchange(ref m_diskUsed, used);
+            return;
+        }
+        m_files.Add(new CachedFile { path = path, size = data.Length, used = DateTime.UtcNow });
+        Interlocked.Exchange(ref m_diskUsed, used + data.Length);
+    }
+
+    void EvictCached(string key) {
+        ScanDisk();
+        string path = Path.Combine(m_directory, key);
+        int index = m_files.FindIndex((f) => f.path == path);
+        if (index < 0) return;
+        try {
+            File.Delete(path);
+        } catch (IOException) {
+        }
+        Interlocked.Add(ref m_diskUsed, -m_files[index].size);
+        m_files.RemoveAt(index);
+    }
+
+    /// <summary>
+    /// Stops loading and destroys the textures. Call on the main thread.
+    /// </summary>
+    public void Dispose() {
+        lock (m_lock) {
+            if (m_stop) return;
+            m_stop = true;
+            Monitor.Pulse(m_lock);
+        }
+        m_thread.Join();
+        foreach (Entry entry in m_entries.Values) {
+            if (entry.texture != null) UnityEngine.Object.Destroy(entry.texture.texture);
+        }
+        m_entries.Clear();
+        m_recent.Clear();
+    }
+}
+
+// Decodes non-interlaced 8-bit PNG images without Unity, so it can run on any thread
+static class PngDecoder {
+    static readonly byte[] Signature = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+    static int ReadInt(byte[] data, int offset) {
+        return (data[offset] << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) | data[offset + 3];
+    }
+
+    // Returns RGBA32 pixels bottom row first, as Unity expects, or null if the image is not supported
+    public static byte[] Decode(byte[] data, out int width, out int height) {
+        width = height = 0;
+        if (data.Length < Signature.Length) return null;
+        for (int i = 0; i < Signature.Length; ++i) if (data[i] != Signature[i]) return null;
+
+        int colorType = -1, channels = 0;
+        byte[] palette = null, alpha = null;
+        var idat = new MemoryStream();
+        for (int offset = Signature.Length; offset + 8 <= data.Length;) {
+            int length = ReadInt(data, offset);
+            string type = System.Text.Encoding.ASCII.GetString(data, offset + 4, 4);
+            int body = offset + 8;
+            if (length < 0 || body + length > data.Length) return null;
+            if (type == "IHDR") {
+                width = ReadInt(data, body);
+                height = ReadInt(data, body + 4);
+                colorType = data[body + 9];
+                if (data[body + 8] != 8 || data[body + 12] != 0) return null; // bit depth and interlace
+                switch (colorType) {
+                    case 0: channels = 1; break;
+                    case 2: channels = 3; break;
+                    case 3: channels = 1; break;
+                    case 4: channels = 2; break;
+                    case 6: channels = 4; break;
+                    default: return null;
+                }
+            } else if (type == "PLTE") {
+                palette = new byte[length];
+                Buffer.BlockCopy(data, body, palette, 0, length);
+            } else if (type == "tRNS") {
+                alpha = new byte[length];
+                Buffer.BlockCopy(data, body, alpha, 0, length);
+            } else if (type == "IDAT") {
+                idat.Write(data, body, length);
+            } else if (type == "IEND") {
+                break;
+            }
+            offset = body + length + 4; // skip CRC
+        }
+        if (channels == 0 || width <= 0 || height <= 0 || (colorType == 3 && palette == null) || idat.Length < 2) return null;
+
+        int stride = width * channels;
+        byte[] raw = new byte[(stride + 1) * height];
+        idat.Position = 2; // zlib header, the adler32 trailer is not checked
+        using (var inflate = new DeflateStream(idat, CompressionMode.Decompress)) {
+            for (int read = 0, n; read < raw.Length; read += n) {
+                n = inflate.Read(raw, read, raw.Length - read);
+                if (n <= 0) return null;
+            }
+        }
+
+        byte[] pixels = new byte[width * height * 4];
+        byte[] previous = new byte[stride], current = new byte[stride];
+        for (int y = 0; y < height; ++y) {
+            int filter = raw[y * (stride + 1)];
+            Buffer.BlockCopy(raw, y * (stride + 1) + 1, current, 0, stride);
+            for (int i = 0; i < stride; ++i) {
+                int a = (i >= channels ? current[i - channels] : 0), b = previous[i], c = (i >= channels ? previous[i - channels] : 0);
+                switch (filter) {
+                    case 0: break;
+                    case 1: current[i] += (byte)a; break;
+                    case 2: current[i] += (byte)b; break;
+                    case 3: current[i] += (byte)((a + b) >> 1); break;
+                    case 4: {
+                        int p = a + b - c, pa = Math.Abs(p - a), pb = Math.Abs(p - b), pc = Math.Abs(p - c);
+                        current[i] += (byte)(pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+                        break;
+                    }
+                    default: return null;
+                }
+            }
+            int o = (height - 1 - y) * width * 4;
+            for (int x = 0; x < width; ++x, o += 4) {
+                switch (colorType) {
+                    case 0:
+                        pixels[o] = pixels[o + 1] = pixels[o + 2] = current[x];
+                        pixels[o + 3] = 255;
+                        break;
+                    case 2:
+                        pixels[o] = current[3 * x];
+                        pixels[o + 1] = current[3 * x + 1];
+                        pixels[o + 2] = current[3 * x + 2];
+                        pixels[o + 3] = 255;
+                        break;
+                    case 3:
+                        int index = current[x];
+                        if (3 * index + 2 >= palette.Length) return null;
+                        pixels[o] = palette[3 * index];
+                        pixels[o + 1] = palette[3 * index + 1];
+                        pixels[o + 2] = palette[3 * index + 2];
+                        pixels[o + 3] = (alpha != null && index < alpha.Length ? alpha[index] : (byte)255);
+                        break;
+                    case 4:
+                        pixels[o] = pixels[o + 1] = pixels[o + 2] = current[2 * x];
+                        pixels[o + 3] = current[2 * x + 1];
+                        break;
+                    case 6:
+                        Buffer.BlockCopy(current, 4 * x, pixels, o, 4);
+                        break;
+                }
+            }
+            byte[] swap = previous; previous = current; current = swap;
+        }
+        return pixels;
+    }
+}
+
+}
@@ -0,0 +1,126 @@
+using UnityEngine;
+
+namespace IndoorAtlas {
+/// <summary>
+/// Caches AR model matrices of a fixed set of geographic anchors, such as the POIs of a venue.
+/// The matrices only change when the AR session's geo-alignment changes, which is detected by
+/// comparing <c>LocationManager.GetArAlignmentVersion</c>, read from memory shared with the native side.
+/// All anchors are then converted with one batched <c>LocationManager.GeoToArMany</c> call, so static
+/// anchors cost no native calls at all while the alignment does not move.
+/// </summary>
+public class GeoToArCache {
+    readonly double[] m_latitudes;
+    readonly double[] m_longitudes;
+    readonly int[] m_floors;
+    readonly float m_heading;
+    readonly float m_zOffset;
+    readonly Matrix4x4[] m_matrices;
+    int m_count;
+    bool m_valid = false;
+
+    /// <summary>
+    /// Creates cache for anchors at the given coordinates. The arrays are not copied.
+    /// </summary>
+    /// <param name="latitudes">Latitudes of the anchors in degrees</param>
+    /// <param name="longitudes">Longitudes of the anchors in degrees</param>
+    /// <param name="floors">Floor numbers of the anchors</param>
+    /// <param name="heading">Heading of the anchors in degrees</param>
+    /// <param name="zOffset">Vertical offset of the anchors from the floor plane in meters</param>
+    public GeoToArCache(double[] latitudes, double[] longitudes, int[] floors, float heading = 0, float zOffset = 0) {
+        m_latitudes = latitudes;
+        m_longitudes = longitudes;
+        m_floors = floors;
+        m_heading = heading;
+        m_zOffset = zOffset;
+        m_matrices = new Matrix4x4[System.Math.Min(latitudes.Length, System.Math.Min(longitudes.Length, floors.Length))];
+        m_count = m_matrices.Length;
+        for (int i = 0; i < m_matrices.Length; ++i) m_matrices[i] = Matrix4x4.identity;
+    }
+
+    /// <summary>
+    /// Creates empty cache for up to capacity anchors, which are set with <c>SetAnchor</c>.
+    /// </summary>
+    public GeoToArCache(int capacity, float heading = 0, float zOffset = 0)
+        : this(new double[capacity], new double[capacity], new int[capacity], heading, zOffset) {
+        m_count = 0;
+    }
+
+    /// <summary>
+    /// Creates cache for the positions of the given POIs.
+    /// </summary>
+    public static GeoToArCache FromPOIs(POI[] pois, float heading = 0, float zOffset = 0) {
+        double[] latitudes = new double[pois.Length];
+        double[] longitudes = new double[pois.Length];
+        int[] floors = new int[pois.Length];
+        for (int i = 0; i < pois.Length; ++i) {
+            latitudes[i] = pois[i].position.coordinate.latitude;
+            longitudes[i] = pois[i].position.coordinate.longitude;
+            floors[i] = pois[i].position.floor;
+        }
+        return new GeoToArCache(latitudes, longitudes, floors, heading, zOffset);
+    }
+
+    /// <summary>
+    /// Maximum number of anchors.
+    /// </summary>
+    public int capacity {
+        get { return m_matrices.Length; }
+    }
+
+    /// <summary>
+    /// Number of anchors, only the first count matrices are valid.
+    /// </summary>
+    public int count {
+        get { return m_count; }
+        set {
+            if (value < 0 || value > m_matrices.Length) throw new System.ArgumentOutOfRangeException("count");
+            m_count = value;
+            m_valid = false;
+        }
+    }
+
+    /// <summary>
+    /// Sets the coordinates of the index'th anchor, the matrices are recomputed on the next update.
+    /// </summary>
+    public void SetAnchor(int index, double latitude, double longitude, int floor) {
+        m_latitudes[index] = latitude;
+        m_longitudes[index] = longitude;
+        m_floors[index] = floor;
+        m_valid = false;
+    }
+
+    /// <summary>
+    /// AR model matrices of the anchors in Unity coordinates, in the same order as the anchors.
+    /// Identity if the anchor could not be converted.
+    /// </summary>
+    public Matrix4x4[] matrices {
+        get { return m_matrices; }
+    }
+
+    /// <summary>
+    /// The <c>LocationManager.GetArAlignmentVersion</c> the matrices were computed with.
+    /// </summary>
+    public int alignmentVersion { get; private set; }
+
+    /// <summary>
+    /// Recomputes the matrices if the geo-alignment has changed since the previous call.
+    /// </summary>
+    /// <returns>True if the matrices were recomputed.</returns>
+    public bool Update(LocationManager manager) {
+        if (m_count == 0) return false;
+        int version = manager.GetArAlignmentVersion();
+        if (m_valid && version == alignmentVersion) return false;
+        manager.GeoToArMany(m_latitudes, m_longitudes, m_floors, m_matrices, m_count, m_heading, m_zOffset);
+        alignmentVersion = version;
+        m_valid = true;
+        return true;
+    }
+
+    /// <summary>
+    /// Forces the matrices to be recomputed on the next update.
+    /// </summary>
+    public void Invalidate() {
+        m_valid = false;
+    }
+}
+}
@@ -0,0 +1,190 @@
+using System.Collections.Generic;
+using UnityEngine;
+
+namespace IndoorAtlas {
+/// <summary>
+/// Tests locations against the polygons of venue geofences on the client side.
+/// The polygons are converted to local (east, north) metric coordinates once, and each one is placed in the
+/// cells of a uniform per-floor grid overlapping its bounding box. A containment query only tests the
+/// bounding boxes and polygons registered in the single cell of the location, so its cost depends on how
+/// many geofences overlap there rather than on the number of geofences in the venue.
+/// </summary>
+public class GeofenceIndex {
+    readonly Geofence[] m_geofences;
+    readonly float m_cellSize;
+    readonly WGSConversion m_conversion = new WGSConversion();
+    readonly Dictionary<long, List<int>> m_cells = new Dictionary<long, List<int>>();
+    // Vertices of geofence i are m_vertices[m_first[i]] .. m_vertices[m_first[i + 1] - 1]
+    readonly Vector2[] m_vertices;
+    readonly int[] m_first;
+    readonly Vector2[] m_min, m_max;
+    // Geofences containing the location passed to the latest Update
+    readonly bool[] m_inside;
+    readonly List<int> m_current = new List<int>();
+    readonly List<int> m_previous = new List<int>();
+
+    /// <summary>
+    /// Builds index for the given geofences. Geofences with less than three points never contain anything.
+    /// </summary>
+    /// <param name="geofences">Geofences to index, usually <c>Venue.geofences</c></param>
+    /// <param name="cellSize">Size of a grid cell in meters</param>
+    public GeofenceIndex(Geofence[] geofences, float cellSize = 10.0f) {
+        m_geofences = geofences;
+        m_cellSize = cellSize;
+        m_first = new int[geofences.Length + 1];
+        m_min = new Vector2[geofences.Length];
+        m_max = new Vector2[geofences.Length];
+        m_inside = new bool[geofences.Length];
+
+        int total = 0;
+        for (int i = 0; i < geofences.Length; ++i) {
+            m_first[i] = total;
+            total += PointCount(geofences[i]);
+        }
+        m_first[geofences.Length] = total;
+
+        // Flatten the polygons so that all vertices are converted in a single pass
+        double[] latitudes = new double[total], longitudes = new double[total];
+        double latitude = 0, longitude = 0;
+        for (int i = 0; i < geofences.Length; ++i) {
+            for (int v = m_first[i]; v < m_first[i + 1]; ++v) {
+                WGS84 point = geofences[i].points[v - m_first[i]];
+                latitudes[v] = point.latitude;
+                longitudes[v] = point.longitude;
+                latitude += point.latitude / total;
+                longitude += point.longitude / total;
+            }
+        }
+        m_conversion.SetOrigin(latitude, longitude);
+        // The origin is at the center of the venue, so the vertices fit in single precision
+        double[] easts = new double[total], norths = new double[total];
+        m_conversion.WGStoEN(latitudes, longitudes, easts, norths, 0, total);
+        m_vertices = new Vector2[total];
+        for (int v = 0; v < total; ++v) m_vertices[v] = new Vector2((float)easts[v], (float)norths[v]);
+
+        for (int i = 0; i < geofences.Length; ++i) {
+            if (m_first[i + 1] - m_first[i] < 3) continue;
+            Vector2 min = m_vertices[m_first[i]], max = min;
+            for (int v = m_first[i] + 1; v < m_first[i + 1]; ++v) {
+                min = Vector2.Min(min, m_vertices[v]);
+                max = Vector2.Max(max, m_vertices[v]);
+            }
+            m_min[i] = min;
+            m_max[i] = max;
+            int floor = geofences[i].position.floor;
+            for (int x = Cell(min.x); x <= Cell(max.x); ++x) {
+                for (int y = Cell(min.y); y <= Cell(max.y); ++y) {
+                    long key = CellKey(floor, x, y);
+                    List<int> cell;
+                    if (!m_cells.TryGetValue(key, out cell)) m_cells.Add(key, cell = new List<int>());
+                    cell.Add(i);
+                }
+            }
+        }
+    }
+
+    static int PointCount(Geofence geofence) {
+        return (geofence.points != null && geofence.points.Length >= 3 ? geofence.points.Length : 0);
+    }
+
+    /// <summary>
+    /// The indexed geofences.
+    /// </summary>
+    public Geofence[] geofences {
+        get { return m_geofences; }
+    }
+
+    /// <summary>
+    /// Converts (latitude, longitude) to the local (east, north) coordinates of this index.
+    /// </summary>
+    public Vector2 ToEN(double latitude, double longitude) {
+        return m_conversion.WGStoEN(latitude, longitude);
+    }
+
+    int Cell(float coordinate) {
+        return Mathf.FloorToInt(coordinate / m_cellSize);
+    }
+
+    static long CellKey(int floor, int x, int y) {
+        return ((long)floor << 42) ^ ((long)(x & 0x1FFFFF) << 21) ^ (long)(y & 0x1FFFFF);
+    }
+
+    // Even-odd rule, the polygon is implicitly closed from the last vertex to the first
+    bool PolygonContains(int index, Vector2 p) {
+        bool inside = false;
+        int end = m_first[index + 1];
+        for (int i = m_first[index], j = end - 1; i < end; j = i++) {
+            Vector2 a = m_vertices[i], b = m_vertices[j];
+            if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) inside = !inside;
+        }
+        return inside;
+    }
+
+    /// <summary>
+    /// Whether the geofence at index contains (latitude, longitude). The floor is not checked.
+    /// </summary>
+    public bool Contains(int index, double latitude, double longitude) {
+        if (m_first[index + 1] - m_first[index] < 3) return false;
+        Vector2 p = ToEN(latitude, longitude);
+        if (p.x < m_min[index].x || p.y < m_min[index].y || p.x > m_max[index].x || p.y > m_max[index].y) return false;
+        return PolygonContains(index, p);
+    }
+
+    /// <summary>
+    /// Finds the geofences on the given floor that contain (latitude, longitude).
+    /// </summary>
+    /// <param name="latitude">Latitude in degrees</param>
+    /// <param name="longitude">Longitude in degrees</param>
+    /// <param name="floor">Floor number</param>
+    /// <param name="results">Cleared and filled with indices to <c>geofences</c></param>
+    public void Query(double latitude, double longitude, int floor, List<int> results) {
+        results.Clear();
+        Vector2 p = ToEN(latitude, longitude);
+        List<int> cell;
+        if (!m_cells.TryGetValue(CellKey(floor, Cell(p.x), Cell(p.y)), out cell)) return;
+        foreach (int i in cell) {
+            if (p.x < m_min[i].x || p.y < m_min[i].y || p.x > m_max[i].x || p.y > m_max[i].y) continue;
+            if (PolygonContains(i, p)) results.Add(i);
+        }
+    }
+
+    /// <summary>
+    /// Finds the geofences containing the new location and compares them to those of the previous call.
+    /// </summary>
+    /// <param name="latitude">Latitude in degrees</param>
+    /// <param name="longitude">Longitude in degrees</param>
+    /// <param name="floor">Floor number</param>
+    /// <param name="entered">Cleared and filled with indices of geofences that contain the location but did not contain the previous one</param>
+    /// <param name="exited">Cleared and filled with indices of geofences that contained the previous location but not this one</param>
+    public void Update(double latitude, double longitude, int floor, List<int> entered, List<int> exited) {
+        entered.Clear();
+        exited.Clear();
+        m_previous.Clear();
+        m_previous.AddRange(m_current);
+        Query(latitude, longitude, floor, m_current);
+        foreach (int i in m_current) {
+            if (!m_inside[i]) entered.Add(i);
+        }
+        foreach (int i in m_previous) m_inside[i] = false;
+        foreach (int i in m_current) m_inside[i] = true;
+        foreach (int i in m_previous) {
+            if (!m_inside[i]) exited.Add(i);
+        }
+    }
+
+    /// <summary>
+    /// Indices of the geofences containing the location passed to the latest <c>Update</c>, do not modify it.
+    /// </summary>
+    public List<int> current {
+        get { return m_current; }
+    }
+
+    /// <summary>
+    /// Forgets the location of the previous <c>Update</c>, so the next one reports all containing geofences as entered.
+    /// </summary>
+    public void Reset() {
+        foreach (int i in m_current) m_inside[i] = false;
+        m_current.Clear();
+    }
+}
+}
@@ -0,0 +1,98 @@
+using System.Collections.Generic;
+using UnityEngine;
+
+namespace IndoorAtlas {
+/// <summary>
+/// A uniform grid index of venue POIs in local (east, north) metric coordinates, bucketed by floor.
+/// Finding the POIs near a location only visits the grid cells overlapping the search radius,
+/// so the cost of a query depends on POI density rather than on the number of POIs in the venue.
+/// </summary>
+public class POIIndex {
+    readonly POI[] m_pois;
+    readonly Vector2[] m_positions;
+    readonly float m_cellSize;
+    readonly WGSConversion m_conversion = new WGSConversion();
+    readonly Dictionary<long, List<int>> m_cells = new Dictionary<long, List<int>>();
+    readonly float[] m_distances;
+    readonly System.Comparison<int> m_nearestFirst;
+
+    /// <summary>
+    /// Builds index for the given POIs.
+    /// </summary>
+    /// <param name="pois">POIs to index, usually <c>Venue.pois</c></param>
+    /// <param name="cellSize">Size of a grid cell in meters</param>
+    public POIIndex(POI[] pois, float cellSize = 10.0f) {
+        m_pois = pois;
+        m_cellSize = cellSize;
+        m_positions = new Vector2[pois.Length];
+        m_distances = new float[pois.Length];
+        m_nearestFirst = (a, b) => m_distances[a].CompareTo(m_distances[b]);
+
+        double latitude = 0, longitude = 0;
+        foreach (POI poi in pois) {
+            latitude += poi.position.coordinate.latitude / pois.Length;
+            longitude += poi.position.coordinate.longitude / pois.Length;
+        }
+        m_conversion.SetOrigin(latitude, longitude);
+
+        for (int i = 0; i < pois.Length; ++i) {
+            m_positions[i] = m_conversion.WGStoEN(pois[i].position.coordinate.latitude, pois[i].position.coordinate.longitude);
+            long key = CellKey(pois[i].position.floor, Cell(m_positions[i].x), Cell(m_positions[i].y));
+            List<int> cell;
+            if (!m_cells.TryGetValue(key, out cell)) m_cells.Add(key, cell = new List<int>());
+            cell.Add(i);
+        }
+    }
+
+    /// <summary>
+    /// The indexed POIs.
+    /// </summary>
+    public POI[] pois {
+        get { return m_pois; }
+    }
+
+    /// <summary>
+    /// Converts (latitude, longitude) to the local (east, north) coordinates of this index.
+    /// </summary>
+    public Vector2 ToEN(double latitude, double longitude) {
+        return m_conversion.WGStoEN(latitude, longitude);
+    }
+
+    int Cell(float coordinate) {
+        return Mathf.FloorToInt(coordinate / m_cellSize);
+    }
+
+    static long CellKey(int floor, int x, int y) {
+        return ((long)floor << 42) ^ ((long)(x & 0x1FFFFF) << 21) ^ (long)(y & 0x1FFFFF);
+    }
+
+    /// <summary>
+    /// Finds the POIs on the given floor within radius meters of (latitude, longitude).
+    /// </summary>
+    /// <param name="latitude">Latitude in degrees</param>
+    /// <param name="longitude">Longitude in degrees</param>
+    /// <param name="floor">Floor number</param>
+    /// <param name="radius">Search radius in meters</param>
+    /// <param name="results">Cleared and filled with indices to <c>pois</c>, nearest first</param>
+    public void Query(double latitude, double longitude, int floor, float radius, List<int> results) {
+        results.Clear();
+        Vector2 center = ToEN(latitude, longitude);
+        int x0 = Cell(center.x - radius), x1 = Cell(center.x + radius);
+        int y0 = Cell(center.y - radius), y1 = Cell(center.y + radius);
+        float radius2 = radius * radius;
+        for (int x = x0; x <= x1; ++x) {
+            for (int y = y0; y <= y1; ++y) {
+                List<int> cell;
+                if (!m_cells.TryGetValue(CellKey(floor, x, y), out cell)) continue;
+                foreach (int i in cell) {
+                    float distance2 = (m_positions[i] - center).sqrMagnitude;
+                    if (distance2 > radius2) continue;
+                    m_distances[i] = distance2;
+                    results.Add(i);
+                }
+            }
+        }
+        results.Sort(m_nearestFirst);
+    }
+}
+}
@@ -0,0 +1,234 @@
+using System;
+using UnityEngine;
+
+namespace IndoorAtlas {
+
+/// <summary>
+/// Power and performance profile selected by <c>IndoorAtlasPowerProfiles</c>.
+/// </summary>
+public enum PowerProfile {
+    // Not moving or not positioning, coarse updates only
+    Idle,
+    // Moving without AR wayfinding
+    Walking,
+    // AR wayfinding is active, full rate updates and plane submission
+    ARNavigation,
+}
+
+/// <summary>
+/// Session filters and AR plane submission rate applied for a <c>PowerProfile</c>.
+/// </summary>
+[Serializable]
+public struct PowerProfileSettings {
+    [Tooltip("The minimum distance measured in meters that the device must move horizontally before an update event is generated.")]
+    public double distanceFilter;
+    [Tooltip("The minimum amount of time measured in seconds that must be elapsed before an update event is generated.")]
+    public double timeFilter;
+    [Tooltip("The minimum angular change in degrees required to generate a new heading event.")]
+    public double headingFilter;
+    [Tooltip("The minimum angular change in degrees required to generate a new attitude event.")]
+    public double attitudeFilter;
+    [Tooltip("Minimum time in seconds between sending changed AR planes, 0 sends them on every AR frame.")]
+    public float planeSubmitInterval;
+}
+
+/// <summary>
+/// Switches the filters of the <c>IndoorAtlasSession</c> on the same game object between profiles, so that
+/// sensor and CPU budget is only spent while the user is actually navigating.
+/// ARNavigation is used while an enabled <c>IndoorAtlasARWayfinding</c> has wayfinding on, Idle while the
+/// positioning service is not available or the speed estimated from location updates stays below
+/// <c>idleSpeed</c> for <c>idleDelay</c> seconds, and Walking once the speed exceeds <c>walkingSpeed</c>.
+/// </summary>
+[DisallowMultipleComponent]
+[RequireComponent(typeof(IndoorAtlasSession))]
+[AddComponentMenu("IndoorAtlas/IndoorAtlas Power Profiles")]
+public class IndoorAtlasPowerProfiles : MonoBehaviour {
+    IndoorAtlasSession m_session;
+
+    [Header("IndoorAtlas power profiles")]
+
+    [SerializeField]
+    PowerProfileSettings m_idle = new PowerProfileSettings {
+        distanceFilter = 2.0, timeFilter = 10.0, headingFilter = 10.0, attitudeFilter = 10.0, planeSubmitInterval = 2.0f };
+
+    [SerializeField]
+    PowerProfileSettings m_walking = new PowerProfileSettings {
+        distanceFilter = 0.7, timeFilter = 2.0, headingFilter = 1.0, attitudeFilter = 1.0, planeSubmitInterval = 0.5f };
+
+    [SerializeField]
+    PowerProfileSettings m_arNavigation = new PowerProfileSettings {
+        distanceFilter = 0.3, timeFilter = 0.5, headingFilter = 0.5, attitudeFilter = 0.5, planeSubmitInterval = 0.0f };
+
+    [SerializeField]
+    [Tooltip("Speed in meters per second above which the user is considered walking.")]
+    float m_walkingSpeed = 0.5f;
+
+    /// <summary>
+    /// Speed in meters per second above which the user is considered walking.
+    /// </summary>
+    public float walkingSpeed
+    {
+        get { return m_walkingSpeed; }
+        set { m_walkingSpeed = value; }
+    }
+
+    [SerializeField]
+    [Tooltip("Speed in meters per second below which the user is considered idle, lower than the walking speed for hysteresis.")]
+    float m_idleSpeed = 0.2f;
+
+    /// <summary>
+    /// Speed in meters per second below which the user is considered idle, lower than <c>walkingSpeed</c> for hysteresis.
+    /// </summary>
+    public float idleSpeed
+    {
+        get { return m_idleSpeed; }
+        set { m_idleSpeed = value; }
+    }
+
+    [SerializeField]
+    [Tooltip("Seconds the speed must stay below the idle speed before switching to the idle profile.")]
+    float m_idleDelay = 10.0f;
+
+    /// <summary>
+    /// Seconds the speed must stay below <c>idleSpeed</c> before switching to the idle profile.
+    /// </summary>
+    public float idleDelay
+    {
+        get { return m_idleDelay; }
+        set { m_idleDelay = value; }
+    }
+
+    [SerializeField]
+    [Tooltip("AR wayfinding whose state selects the AR navigation profile, found among the children if not set.")]
+    IndoorAtlasARWayfinding m_arWayfinding;
+
+    /// <summary>
+    /// AR wayfinding whose state selects the AR navigation profile, found among the children if not set.
+    /// </summary>
+    public IndoorAtlasARWayfinding arWayfinding
+    {
+        get { return m_arWayfinding; }
+        set { m_arWayfinding = value; m_applied = false; }
+    }
+
+    /// <summary>
+    /// Invoked when the profile changes.
+    /// </summary>
+    public event Action<PowerProfile> profileChanged;
+
+    /// <summary>
+    /// The profile currently applied.
+    /// </summary>
+    public PowerProfile profile { get; private set; }
+
+    /// <summary>
+    /// Smoothed speed in meters per second estimated from location updates.
+    /// </summary>
+    public float speed { get; private set; }
+
+    // Weight of the newest sample in the smoothed speed
+    const float SpeedSmoothing = 0.3f;
+
+    bool m_applied = false;
+    bool m_available = false;
+    bool m_hasLocation = false;
+    LocationData m_lastLocation;
+    float m_lastLocationTime = 0;
+    float m_slowSince = 0;
+
+    /// <summary>
+    /// Settings applied for the given profile.
+    /// </summary>
+    public PowerProfileSettings GetSettings(PowerProfile p) {
+        switch (p) {
+            case PowerProfile.Walking: return m_walking;
+            case PowerProfile.ARNavigation: return m_arNavigation;
+        }
+        return m_idle;
+    }
+
+    /// <summary>
+    /// Replaces the settings of the given profile, applied immediately if it is the current one.
+    /// </summary>
+    public void SetSettings(PowerProfile p, PowerProfileSettings settings) {
+        switch (p) {
+            case PowerProfile.Idle: m_idle = settings; break;
+            case PowerProfile.Walking: m_walking = settings; break;
+            case PowerProfile.ARNavigation: m_arNavigation = settings; break;
+        }
+        if (p == profile) m_applied = false;
+    }
+
+    void Awake() {
+        m_session = GetComponent<IndoorAtlasSession>();
+        if (!m_arWayfinding) m_arWayfinding = GetComponentInChildren<IndoorAtlasARWayfinding>(true);
+    }
+
+    void OnEnable() {
+        m_session.locationDataChanged += OnLocationChanged;
+        m_session.statusChanged += OnStatusChanged;
+        m_hasLocation = false;
+        m_slowSince = Time.unscaledTime;
+        m_applied = false;
+    }
+
+    void OnDisable() {
+        m_session.locationDataChanged -= OnLocationChanged;
+        m_session.statusChanged -= OnStatusChanged;
+    }
+
+    bool IsNavigating() {
+        return m_arWayfinding && m_arWayfinding.isActiveAndEnabled && m_arWayfinding.wayfinding;
+    }
+
+    PowerProfile SelectProfile() {
+        if (IsNavigating()) return PowerProfile.ARNavigation;
+        if (!m_available) return PowerProfile.Idle;
+        if (speed > m_walkingSpeed) return PowerProfile.Walking;
+        if (profile == PowerProfile.Idle || Time.unscaledTime - m_slowSince >= m_idleDelay) return PowerProfile.Idle;
+        return PowerProfile.Walking; // between the thresholds, or not slow for long enough yet
+    }
+
+    void Apply(PowerProfile p) {
+        PowerProfileSettings settings = GetSettings(p);
+        m_session.distanceFilter = settings.distanceFilter;
+        m_session.timeFilter = settings.timeFilter;
+        m_session.headingFilter = settings.headingFilter;
+        m_session.attitudeFilter = settings.attitudeFilter;
+        if (m_arWayfinding) m_arWayfinding.planeSubmitInterval = settings.planeSubmitInterval;
+        bool changed = (p != profile);
+        profile = p;
+        m_applied = true;
+        if (changed && profileChanged != null) profileChanged(p);
+    }
+
+    void Update() {
+        // The distance filter stops updates while standing still, so no updates at all means no speed
+        if (m_hasLocation && Time.unscaledTime - m_lastLocationTime > m_idleDelay) speed = 0;
+        PowerProfile p = SelectProfile();
+        if (!m_applied || p != profile) Apply(p);
+    }
+
+    void OnLocationChanged(in LocationData location) {
+        if (m_hasLocation && location.timestamp > m_lastLocation.timestamp) {
+            // Equirectangular approximation is plenty for the distance between consecutive fixes
+            const double EarthRadius = 6371000.0;
+            double lat = location.latitude * Mathf.Deg2Rad;
+            double dx = (location.longitude - m_lastLocation.longitude) * Mathf.Deg2Rad * Math.Cos(lat) * EarthRadius;
+            double dy = (location.latitude - m_lastLocation.latitude) * Mathf.Deg2Rad * EarthRadius;
+            double seconds = (location.timestamp - m_lastLocation.timestamp) / 1000.0;
+            speed = Mathf.Lerp(speed, (float)(Math.Sqrt(dx * dx + dy * dy) / seconds), SpeedSmoothing);
+        }
+        if (speed >= m_idleSpeed) m_slowSince = Time.unscaledTime;
+        m_lastLocation = location;
+        m_lastLocationTime = Time.unscaledTime;
+        m_hasLocation = true;
+        m_available = true;
+    }
+
+    void OnStatusChanged(Status status) {
+        m_available = (status.status == Status.ServiceStatus.Available || status.status == Status.ServiceStatus.Limited);
+    }
+}
+
+}
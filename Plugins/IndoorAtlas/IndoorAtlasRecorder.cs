@@ -0,0 +1,446 @@
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Text;
+using System.Threading;
+using UnityEngine;
+
+namespace IndoorAtlas {
+
+// Kind of a trace record, the event kinds have the same values as EventType.
+public enum TraceRecordKind : byte {
+    None = 0,
+    Location = 1,
+    Heading = 2,
+    Orientation = 3,
+    Status = 4,
+    EnterRegion = 5,
+    ExitRegion = 6,
+    Route = 7,
+    // Matrix passed to LocationManager.SetArPoseMatrix, in Unity coordinates
+    ArPose = 8,
+    // Matrix passed to LocationManager.SetArCameraToWorldMatrix
+    ArCameraToWorld = 9,
+    // JSON of the extra info, recorded when the positioning session starts
+    ExtraInfo = 10,
+};
+
+// Decoded trace record.
+public struct TraceRecord {
+    public TraceRecordKind kind;
+    // UTC time the session received the record in milliseconds
+    public long time;
+    // Location, Heading, Orientation and Status
+    public EventRecord evt;
+    // JSON of EnterRegion, ExitRegion, Route and ExtraInfo
+    public string text;
+    // ArPose and ArCameraToWorld
+    public Matrix4x4 matrix;
+}
+
+// Session trace format shared by SessionRecorder and SessionTraceReader.
+//
+//   File: "IATR", version byte, records
+//   Record: varint length of the body, body:
+//     byte   kind
+//     svarint time delta from the previous record (ms)
+//     Location:         svarint event timestamp - time, svarint floor,
+//                       svarint latitude and longitude delta from the previous location (1e-7 degrees),
+//                       varint accuracy (cm), svarint altitude (cm), varint bearing (centidegrees)
+//     Heading:          svarint event timestamp - time, varint heading (centidegrees)
+//     Orientation:      svarint event timestamp - time, 4 * svarint x, y, z, w delta from the previous orientation (1/32767)
+//     Status:           svarint status
+//     Region, Route,
+//     ExtraInfo:        varint byte count, UTF-8 JSON
+//     ArPose, ArCamera: 12 * svarint delta of the upper 3x4 part from the previous matrix of the same kind,
+//                       rotation in 1/10000, translation in millimeters
+//
+// varint is unsigned LEB128, svarint is zigzag encoded varint. Readers skip the rest of a body
+// they do not understand, so kinds and fields can be appended without breaking old readers.
+static class TraceFormat {
+    public static readonly byte[] Magic = { (byte)'I', (byte)'A', (byte)'T', (byte)'R' };
+    public const byte Version = 1;
+    public const double DegreeScale = 1e7;
+    public const double CentiScale = 100;
+    public const double QuaternionScale = 32767;
+    public const double RotationScale = 10000;
+    public const double TranslationScale = 1000;
+
+    public static double MatrixScale(int index) {
+        // index is row * 4 + column of the upper 3x4 part
+        return ((index & 3) == 3 ? TranslationScale : RotationScale);
+    }
+}
+
+// State needed to delta-encode or -decode consecutive records.
+struct TraceDeltaState {
+    public long time;
+    public long latitude, longitude;
+    public long qx, qy, qz, qw;
+    public long[] pose, camera;
+
+    public static TraceDeltaState Create() {
+        return new TraceDeltaState { pose = new long[12], camera = new long[12] };
+    }
+}
+
+/// <summary>
+/// Records the events received by <c>IndoorAtlasSession</c> and the AR matrices passed to
+/// <c>LocationManager</c> to a compact binary trace (see <c>TraceFormat</c>), which can be replayed
+/// with <c>IndoorAtlasReplay</c>. Recording only copies the record into a queue on the calling thread,
+/// encoding and file writes happen on a background thread.
+/// </summary>
+public class SessionRecorder : IDisposable {
+    readonly object m_lock = new object();
+    List<TraceRecord> m_queue = new List<TraceRecord>();
+    List<TraceRecord> m_writing = new List<TraceRecord>();
+    readonly Thread m_thread;
+    readonly Stream m_stream;
+    readonly long m_startTime;
+    readonly Stopwatch m_clock = Stopwatch.StartNew();
+    // Venue hashes whose venue content is already in this trace, main thread only
+    readonly Dictionary<string, string> m_venueHashes = new Dictionary<string, string>();
+    bool m_stop = false;
+
+    /// <summary>
+    /// Starts recording to the file at path, an existing file is overwritten.
+    /// </summary>
+    public SessionRecorder(string path) {
+        this.path = path;
+        m_startTime = DateTimeOffset.UtcNow.ToUnixTimeMilliseconds();
+        m_stream = new FileStream(path, FileMode.Create, FileAccess.Write, FileShare.Read, 64 * 1024);
+        m_stream.Write(TraceFormat.Magic, 0, TraceFormat.Magic.Length);
+        m_stream.WriteByte(TraceFormat.Version);
+        m_thread = new Thread(Run) { Name = "IndoorAtlas recorder", IsBackground = true };
+        m_thread.Start();
+    }
+
+    /// <summary>
+    /// Path of the trace file.
+    /// </summary>
+    public string path { get; private set; }
+
+    /// <summary>
+    /// Number of bytes written to the trace so far.
+    /// </summary>
+    public long bytesWritten {
+        get { return Interlocked.Read(ref m_bytesWritten); }
+    }
+    long m_bytesWritten = TraceFormat.Magic.Length + 1;
+
+    long Now() {
+        return m_startTime + m_clock.ElapsedMilliseconds;
+    }
+
+    void Enqueue(ref TraceRecord record) {
+        record.time = Now();
+        lock (m_lock) {
+            m_queue.Add(record);
+            if (m_queue.Count == 1) Monitor.Pulse(m_lock);
+        }
+    }
+
+    /// <summary>
+    /// Records location, heading, orientation or status event.
+    /// </summary>
+    public void Record(ref EventRecord evt) {
+        TraceRecord record = new TraceRecord { kind = (TraceRecordKind)evt.type, evt = evt };
+        Enqueue(ref record);
+    }
+
+    /// <summary>
+    /// Records route, extra info or region event as the JSON received from the native side.
+    /// </summary>
+    public void RecordText(TraceRecordKind kind, string json) {
+        TraceRecord record = new TraceRecord { kind = kind, text = json };
+        Enqueue(ref record);
+    }
+
+    /// <summary>
+    /// Records region event. The native side sends the venue content only the first time it sees a venue,
+    /// which may be before recording started, so the first region of each venue version in the trace is
+    /// recorded re-serialized with the venue resolved by <c>LocationManager.ParseRegion</c>.
+    /// </summary>
+    public void RecordRegion(TraceRecordKind kind, string json, Region region) {
+        string hash;
+        if (region != null && region.venue != null && !string.IsNullOrEmpty(region.venueId) && region.venue.id == region.venueId &&
+            !(m_venueHashes.TryGetValue(region.venueId, out hash) && hash == region.venueHash)) {
+            m_venueHashes[region.venueId] = region.venueHash;
+            json = JsonUtility.ToJson(region);
+        }
+        RecordText(kind, json);
+    }
+
+    /// <summary>
+    /// Records AR pose or camera matrix.
+    /// </summary>
+    public void RecordMatrix(TraceRecordKind kind, Matrix4x4 matrix) {
+        TraceRecord record = new TraceRecord { kind = kind, matrix = matrix };
+        Enqueue(ref record);
+    }
+
+    void Run() {
+        TraceDeltaState state = TraceDeltaState.Create();
+        byte[] body = new byte[256];
+        byte[] length = new byte[5];
+        Stopwatch sinceFlush = Stopwatch.StartNew();
+        for (;;) {
+            bool stop;
+            lock (m_lock) {
+                // wake up at least once a second so that a crash does not lose more than that
+                if (m_queue.Count == 0 && !m_stop) Monitor.Wait(m_lock, 1000);
+                var swap = m_queue; m_queue = m_writing; m_writing = swap;
+                stop = m_stop;
+            }
+            foreach (TraceRecord record in m_writing) {
+                TraceRecord r = record;
+                int size = TraceWriter.Encode(ref r, ref state, ref body);
+                int prefix = TraceWriter.PutVarint(length, 0, (ulong)size);
+                m_stream.Write(length, 0, prefix);
+                m_stream.Write(body, 0, size);
+                Interlocked.Add(ref m_bytesWritten, prefix + size);
+            }
+            m_writing.Clear();
+            if (stop) break;
+            if (sinceFlush.ElapsedMilliseconds >= 1000) {
+                m_stream.Flush();
+                sinceFlush.Reset();
+                sinceFlush.Start();
+            }
+        }
+        m_stream.Dispose();
+    }
+
+    /// <summary>
+    /// Writes the remaining records and closes the trace.
+    /// </summary>
+    public void Dispose() {
+        lock (m_lock) {
+            if (m_stop) return;
+            m_stop = true;
+            Monitor.Pulse(m_lock);
+        }
+        m_thread.Join();
+    }
+}
+
+static class TraceWriter {
+    public static int PutVarint(byte[] buffer, int offset, ulong value) {
+        while (value >= 0x80) {
+            buffer[offset++] = (byte)(value | 0x80);
+            value >>= 7;
+        }
+        buffer[offset++] = (byte)value;
+        return offset;
+    }
+
+    static void Reserve(ref byte[] buffer, int offset, int count) {
+        if (offset + count > buffer.Length) Array.Resize(ref buffer, Math.Max(buffer.Length * 2, offset + count));
+    }
+
+    static int Varint(ref byte[] buffer, int offset, ulong value) {
+        Reserve(ref buffer, offset, 10);
+        return PutVarint(buffer, offset, value);
+    }
+
+    static int Svarint(ref byte[] buffer, int offset, long value) {
+        return Varint(ref buffer, offset, (ulong)((value << 1) ^ (value >> 63)));
+    }
+
+    static long Quantize(double value, double scale) {
+        return (long)Math.Round(value * scale);
+    }
+
+    static int Delta(ref byte[] buffer, int offset, ref long previous, long value) {
+        offset = Svarint(ref buffer, offset, value - previous);
+        previous = value;
+        return offset;
+    }
+
+    // Encodes record body into buffer, which is grown if needed, and returns its size
+    public static int Encode(ref TraceRecord record, ref TraceDeltaState state, ref byte[] buffer) {
+        int o = 0;
+        Reserve(ref buffer, o, 1);
+        buffer[o++] = (byte)record.kind;
+        o = Delta(ref buffer, o, ref state.time, record.time);
+        EventRecord e = record.evt;
+        switch (record.kind) {
+            case TraceRecordKind.Location:
+                o = Svarint(ref buffer, o, e.timestamp - record.time);
+                o = Svarint(ref buffer, o, e.floor);
+                o = Delta(ref buffer, o, ref state.latitude, Quantize(e.v0, TraceFormat.DegreeScale));
+                o = Delta(ref buffer, o, ref state.longitude, Quantize(e.v1, TraceFormat.DegreeScale));
+                o = Varint(ref buffer, o, (ulong)Math.Max(0, Quantize(e.v2, TraceFormat.CentiScale)));
+                o = Svarint(ref buffer, o, Quantize(e.v3, TraceFormat.CentiScale));
+                o = Varint(ref buffer, o, (ulong)Math.Max(0, Quantize(e.v4, TraceFormat.CentiScale)));
+                break;
+            case TraceRecordKind.Heading:
+                o = Svarint(ref buffer, o, e.timestamp - record.time);
+                o = Varint(ref buffer, o, (ulong)Math.Max(0, Quantize(e.v0, TraceFormat.CentiScale)));
+                break;
+            case TraceRecordKind.Orientation:
+                o = Svarint(ref buffer, o, e.timestamp - record.time);
+                o = Delta(ref buffer, o, ref state.qx, Quantize(e.v0, TraceFormat.QuaternionScale));
+                o = Delta(ref buffer, o, ref state.qy, Quantize(e.v1, TraceFormat.QuaternionScale));
+                o = Delta(ref buffer, o, ref state.qz, Quantize(e.v2, TraceFormat.QuaternionScale));
+                o = Delta(ref buffer, o, ref state.qw, Quantize(e.v3, TraceFormat.QuaternionScale));
+                break;
+            case TraceRecordKind.Status:
+                o = Svarint(ref buffer, o, e.code);
+                break;
+            case TraceRecordKind.EnterRegion:
+            case TraceRecordKind.ExitRegion:
+            case TraceRecordKind.Route:
+            case TraceRecordKind.ExtraInfo:
+                string text = record.text ?? "";
+                int count = Encoding.UTF8.GetByteCount(text);
+                o = Varint(ref buffer, o, (ulong)count);
+                Reserve(ref buffer, o, count);
+                o += Encoding.UTF8.GetBytes(text, 0, text.Length, buffer, o);
+                break;
+            case TraceRecordKind.ArPose:
+            case TraceRecordKind.ArCameraToWorld:
+                long[] previous = (record.kind == TraceRecordKind.ArPose ? state.pose : state.camera);
+                for (int i = 0; i < 12; ++i) {
+                    o = Delta(ref buffer, o, ref previous[i], Quantize(record.matrix[i >> 2, i & 3], TraceFormat.MatrixScale(i)));
+                }
+                break;
+        }
+        return o;
+    }
+}
+
+/// <summary>
+/// Reads traces written by <c>SessionRecorder</c>.
+/// </summary>
+public class SessionTraceReader : IDisposable {
+    readonly Stream m_stream;
+    TraceDeltaState m_state = TraceDeltaState.Create();
+    byte[] m_body = new byte[256];
+    int m_offset, m_size;
+
+    /// <summary>
+    /// Returns true if the stream starts with the trace header, the stream position is restored.
+    /// </summary>
+    public static bool IsTrace(Stream stream) {
+        long position = stream.Position;
+        byte[] magic = new byte[TraceFormat.Magic.Length];
+        int read = stream.Read(magic, 0, magic.Length);
+        stream.Position = position;
+        if (read != magic.Length) return false;
+        for (int i = 0; i < magic.Length; ++i) if (magic[i] != TraceFormat.Magic[i]) return false;
+        return true;
+    }
+
+    /// <summary>
+    /// Starts reading trace from the stream, throws <c>InvalidDataException</c> if it is not a trace.
+    /// </summary>
+    public SessionTraceReader(Stream stream) {
+        m_stream = stream;
+        if (!IsTrace(stream)) throw new InvalidDataException("IndoorAtlas: not a session trace");
+        stream.Position += TraceFormat.Magic.Length;
+        int version = stream.ReadByte();
+        if (version != TraceFormat.Version) throw new InvalidDataException("IndoorAtlas: unsupported trace version " + version);
+    }
+
+    ulong StreamVarint(out bool eof) {
+        ulong value = 0;
+        for (int shift = 0; ; shift += 7) {
+            int b = m_stream.ReadByte();
+            if (b < 0) { eof = true; return 0; }
+            value |= (ulong)(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) break;
+        }
+        eof = false;
+        return value;
+    }
+
+    ulong Varint() {
+        ulong value = 0;
+        for (int shift = 0; m_offset < m_size; shift += 7) {
+            byte b = m_body[m_offset++];
+            value |= (ulong)(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) break;
+        }
+        return value;
+    }
+
+    long Svarint() {
+        ulong value = Varint();
+        return (long)(value >> 1) ^ -(long)(value & 1);
+    }
+
+    long Delta(ref long previous) {
+        previous += Svarint();
+        return previous;
+    }
+
+    /// <summary>
+    /// Reads the next record, returns false at the end of the trace.
+    /// </summary>
+    public bool Read(ref TraceRecord record) {
+        bool eof;
+        int size = (int)StreamVarint(out eof);
+        if (eof) return false;
+        if (m_body.Length < size) m_body = new byte[size];
+        m_size = 0;
+        while (m_size < size) {
+            int read = m_stream.Read(m_body, m_size, size - m_size);
+            if (read <= 0) return false; // truncated, e.g. the app was killed while recording
+            m_size += read;
+        }
+        m_offset = 0;
+
+        record = new TraceRecord { kind = (TraceRecordKind)m_body[m_offset++] };
+        record.time = Delta(ref m_state.time);
+        EventRecord e = new EventRecord { type = (EventType)record.kind };
+        switch (record.kind) {
+            case TraceRecordKind.Location:
+                e.timestamp = record.time + Svarint();
+                e.floor = (int)Svarint();
+                e.v0 = Delta(ref m_state.latitude) / TraceFormat.DegreeScale;
+                e.v1 = Delta(ref m_state.longitude) / TraceFormat.DegreeScale;
+                e.v2 = Varint() / TraceFormat.CentiScale;
+                e.v3 = Svarint() / TraceFormat.CentiScale;
+                e.v4 = Varint() / TraceFormat.CentiScale;
+                break;
+            case TraceRecordKind.Heading:
+                e.timestamp = record.time + Svarint();
+                e.v0 = Varint() / TraceFormat.CentiScale;
+                break;
+            case TraceRecordKind.Orientation:
+                e.timestamp = record.time + Svarint();
+                e.v0 = Delta(ref m_state.qx) / TraceFormat.QuaternionScale;
+                e.v1 = Delta(ref m_state.qy) / TraceFormat.QuaternionScale;
+                e.v2 = Delta(ref m_state.qz) / TraceFormat.QuaternionScale;
+                e.v3 = Delta(ref m_state.qw) / TraceFormat.QuaternionScale;
+                break;
+            case TraceRecordKind.Status:
+                e.code = (int)Svarint();
+                break;
+            case TraceRecordKind.EnterRegion:
+            case TraceRecordKind.ExitRegion:
+            case TraceRecordKind.Route:
+            case TraceRecordKind.ExtraInfo:
+                int count = (int)Varint();
+                record.text = Encoding.UTF8.GetString(m_body, m_offset, Math.Min(count, m_size - m_offset));
+                break;
+            case TraceRecordKind.ArPose:
+            case TraceRecordKind.ArCameraToWorld:
+                long[] previous = (record.kind == TraceRecordKind.ArPose ? m_state.pose : m_state.camera);
+                Matrix4x4 matrix = Matrix4x4.identity;
+                for (int i = 0; i < 12; ++i) matrix[i >> 2, i & 3] = (float)(Delta(ref previous[i]) / TraceFormat.MatrixScale(i));
+                record.matrix = matrix;
+                break;
+        }
+        if (record.kind >= TraceRecordKind.Location && record.kind <= TraceRecordKind.Status) record.evt = e;
+        return true;
+    }
+
+    public void Dispose() {
+        m_stream.Dispose();
+    }
+}
+
+}
@@ -0,0 +1,233 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Runtime.InteropServices;
+using UnityEngine;
+
+namespace IndoorAtlas {
+/// <summary>
+/// Backend of <c>LocationManager</c> on platforms other than iOS and Android (editor, desktop and headless
+/// Linux builds). Replays a recorded trace through the same <c>NativeIndoorAtlasOn*</c> callbacks and binary
+/// event buffer as the native SDKs, so the session and AR wayfinding pipeline can be run and profiled without a device.
+///
+/// The trace is a text file with one event per line: <c>timestamp&lt;TAB&gt;callback&lt;TAB&gt;payload</c>, where timestamp
+/// is in milliseconds, callback is the name of a <c>NativeIndoorAtlasOn*</c> method of <c>IndoorAtlasSession</c> and
+/// payload is its JSON argument exactly as the native side sends it. Empty lines and lines starting with # are ignored.
+///
+/// Binary traces written by <c>SessionRecorder</c> are replayed too, their AR matrices are skipped.
+///
+/// The trace is set with <c>IndoorAtlasSession.replayTrace</c>, or from the command line of a standalone build with
+/// <c>-indooratlas-replay &lt;path&gt;</c> and <c>-indooratlas-replay-speed &lt;multiplier&gt;</c>.
+/// </summary>
+[DefaultExecutionOrder(-2)]
+[AddComponentMenu("")]
+public class IndoorAtlasReplay : MonoBehaviour {
+    struct Entry {
+        public long timestamp;
+        public string callback;
+        public string payload;
+        // Location, heading, orientation and status are converted once at load for the binary transport
+        public EventRecord record;
+    }
+
+    const int RingCapacity = 64;
+
+    readonly List<Entry> m_entries = new List<Entry>();
+    int m_next = 0;
+    double m_clock = 0;
+    bool m_running = false;
+    string m_target;
+    GameObject m_targetObject;
+    IntPtr m_buffer = IntPtr.Zero;
+    EventBuffer m_events;
+
+    /// <summary>
+    /// Playback speed multiplier, 1 replays in real time.
+    /// </summary>
+    public float speed { get; set; }
+
+    /// <summary>
+    /// How events are delivered, same as on the native side.
+    /// </summary>
+    public EventTransport transport { get; set; }
+
+    /// <summary>
+    /// Path of the replayed trace.
+    /// </summary>
+    public string path { get; private set; }
+
+    /// <summary>
+    /// True once every event of the trace has been delivered.
+    /// </summary>
+    public bool finished {
+        get { return m_next >= m_entries.Count; }
+    }
+
+    internal EventBuffer events {
+        get { return m_events; }
+    }
+
+    /// <summary>
+    /// Returns the trace path and speed given on the command line, or the arguments if there are none.
+    /// </summary>
+    public static void ResolveCommandLine(ref string path, ref float speed) {
+        string[] args = Environment.GetCommandLineArgs();
+        for (int i = 0; i + 1 < args.Length; ++i) {
+            if (args[i] == "-indooratlas-replay") path = args[i + 1];
+            else if (args[i] == "-indooratlas-replay-speed") float.TryParse(args[i + 1], System.Globalization.NumberStyles.Float, System.Globalization.CultureInfo.InvariantCulture, out speed);
+        }
+    }
+
+    /// <summary>
+    /// Creates hidden game object that replays the trace at path to the game object named target.
+    /// </summary>
+    internal static IndoorAtlasReplay Create(string path, float speed, string target) {
+        var go = new GameObject("IndoorAtlas Replay");
+        go.hideFlags = HideFlags.HideAndDontSave;
+        DontDestroyOnLoad(go);
+        var replay = go.AddComponent<IndoorAtlasReplay>();
+        replay.Load(path);
+        replay.speed = speed;
+        replay.m_target = target;
+        return replay;
+    }
+
+    static bool ToRecord(string callback, string payload, ref EventRecord record) {
+        switch (callback) {
+            case "NativeIndoorAtlasOnLocationChanged":
+                Location location = JsonUtility.FromJson<Location>(payload);
+                record = new EventRecord { type = EventType.Location, timestamp = location.timestamp, floor = location.position.floor,
+                    v0 = location.position.coordinate.latitude, v1 = location.position.coordinate.longitude,
+                    v2 = location.accuracy, v3 = location.altitude, v4 = location.bearing };
+                return true;
+            case "NativeIndoorAtlasOnHeadingChanged":
+                Heading heading = JsonUtility.FromJson<Heading>(payload);
+                record = new EventRecord { type = EventType.Heading, timestamp = heading.timestamp, v0 = heading.heading };
+                return true;
+            case "NativeIndoorAtlasOnOrientationChanged":
+                Orientation orientation = JsonUtility.FromJson<Orientation>(payload);
+                record = new EventRecord { type = EventType.Orientation, timestamp = orientation.timestamp,
+                    v0 = orientation.x, v1 = orientation.y, v2 = orientation.z, v3 = orientation.w };
+                return true;
+            case "NativeIndoorAtlasOnStatusChanged":
+                Status status = JsonUtility.FromJson<Status>(payload);
+                record = new EventRecord { type = EventType.Status, code = (int)status.status };
+                return true;
+        }
+        return false;
+    }
+
+    static string ToPayload(ref EventRecord e) {
+        switch (e.type) {
+            case EventType.Location:
+                return JsonUtility.ToJson(new Location {
+                    accuracy = (float)e.v2, altitude = e.v3, bearing = (float)e.v4, timestamp = e.timestamp,
+                    position = new LatLngFloor { coordinate = new WGS84 { latitude = e.v0, longitude = e.v1 }, floor = e.floor } });
+            case EventType.Heading:
+                return JsonUtility.ToJson(new Heading { heading = e.v0, timestamp = e.timestamp });
+            case EventType.Orientation:
+                return JsonUtility.ToJson(new Orientation { x = e.v0, y = e.v1, z = e.v2, w = e.v3, timestamp = e.timestamp });
+            case EventType.Status:
+                return JsonUtility.ToJson(new Status { status = (Status.ServiceStatus)e.code });
+        }
+        return "";
+    }
+
+    static readonly string[] s_callbacks = {
+        null,
+        "NativeIndoorAtlasOnLocationChanged",
+        "NativeIndoorAtlasOnHeadingChanged",
+        "NativeIndoorAtlasOnOrientationChanged",
+        "NativeIndoorAtlasOnStatusChanged",
+        "NativeIndoorAtlasOnEnterRegion",
+        "NativeIndoorAtlasOnExitRegion",
+        "NativeIndoorAtlasOnRoute",
+        null,
+        null,
+        "NativeIndoorAtlasOnExtraInfo",
+    };
+
+    bool LoadRecording(string tracePath) {
+        using (var stream = File.OpenRead(tracePath)) {
+            if (!SessionTraceReader.IsTrace(stream)) return false;
+        }
+        using (var reader = new SessionTraceReader(File.OpenRead(tracePath))) {
+            TraceRecord record = new TraceRecord();
+            while (reader.Read(ref record)) {
+                if ((int)record.kind >= s_callbacks.Length || s_callbacks[(int)record.kind] == null) continue;
+                Entry entry = new Entry { timestamp = record.time, callback = s_callbacks[(int)record.kind] };
+                if (record.kind <= TraceRecordKind.Status) {
+                    entry.record = record.evt;
+                    entry.payload = ToPayload(ref record.evt);
+                } else {
+                    entry.payload = record.text;
+                }
+                m_entries.Add(entry);
+            }
+        }
+        return true;
+    }
+
+    void Load(string tracePath) {
+        path = tracePath;
+        if (!LoadRecording(tracePath)) LoadText(tracePath);
+        if (m_entries.Count > 0) m_clock = m_entries[0].timestamp;
+        m_buffer = EventBuffer.Allocate(RingCapacity);
+        m_events = new EventBuffer(m_buffer);
+    }
+
+    void LoadText(string tracePath) {
+        foreach (string line in File.ReadLines(tracePath)) {
+            if (line.Length == 0 || line[0] == '#') continue;
+            string[] fields = line.Split(new char[] { '\t' }, 3);
+            if (fields.Length != 3) {
+                Debug.LogWarning("IndoorAtlas: ignoring malformed trace line: " + line);
+                continue;
+            }
+            Entry entry = new Entry { timestamp = long.Parse(fields[0]), callback = fields[1], payload = fields[2] };
+            ToRecord(entry.callback, entry.payload, ref entry.record);
+            m_entries.Add(entry);
+        }
+    }
+
+    /// <summary>
+    /// Starts or resumes the replay.
+    /// </summary>
+    public void Play() {
+        m_running = true;
+    }
+
+    /// <summary>
+    /// Pauses the replay, events are not delivered until <c>Play</c> is called.
+    /// </summary>
+    public void Pause() {
+        m_running = false;
+    }
+
+    /// <summary>
+    /// Delivers all events up to milliseconds of trace time from the current position.
+    /// </summary>
+    public void Advance(double milliseconds) {
+        m_clock += milliseconds;
+        if (!m_targetObject) m_targetObject = GameObject.Find(m_target);
+        for (; m_next < m_entries.Count && m_entries[m_next].timestamp <= m_clock; ++m_next) {
+            Entry entry = m_entries[m_next];
+            if (transport == EventTransport.Binary && entry.record.type != EventType.None) {
+                m_events.Push(ref entry.record);
+            } else if (m_targetObject) {
+                m_targetObject.SendMessage(entry.callback, entry.payload, SendMessageOptions.DontRequireReceiver);
+            }
+        }
+    }
+
+    void Update() {
+        if (m_running) Advance(Time.unscaledDeltaTime * 1000.0 * speed);
+    }
+
+    void OnDestroy() {
+        m_events = null;
+        if (m_buffer != IntPtr.Zero) Marshal.FreeHGlobal(m_buffer);
+        m_buffer = IntPtr.Zero;
+    }
+}
+}
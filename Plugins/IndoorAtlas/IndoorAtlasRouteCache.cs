@@ -0,0 +1,269 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Threading;
+using UnityEngine;
+
+namespace IndoorAtlas {
+
+// Run of consecutive route legs that start on the same floor.
+[Serializable]
+[StructLayout(LayoutKind.Sequential)]
+public struct RouteFloorSegment {
+    // Floor level of the legs.
+    public int floor;
+    // Index of the first leg and number of legs in the segment.
+    public int firstLeg, legCount;
+    // Distance in meters from the start of the route to the start of the segment.
+    public double startDistance;
+    // Length of the segment in meters.
+    public double length;
+}
+
+/// <summary>
+/// Immutable wayfinding route with data derived from it: cumulative distance per leg, per-floor segments,
+/// turns and the legs in local metric coordinates for locating the user on the route.
+/// Built off the main thread by <c>RouteCache</c>, get the latest one with <c>LocationManager.GetRoute</c>.
+/// </summary>
+public sealed class RouteSnapshot {
+    // Heading change in degrees between consecutive legs that counts as a turn
+    const double TurnAngle = 30.0;
+
+    readonly RouteLegData[] m_legs;
+    readonly double[] m_legEnd;
+    readonly RouteFloorSegment[] m_segments;
+    readonly int[] m_turns;
+    // Begin and end points of the legs as (east, north) pairs around the start of the route
+    readonly Vector2[] m_points;
+    readonly WGSConversion m_conversion = new WGSConversion();
+
+    /// <summary>
+    /// The parsed route, as passed to <c>IndoorAtlasSession.routeUpdated</c>. Do not modify it.
+    /// </summary>
+    public Route route { get; private set; }
+
+    /// <summary>
+    /// Number of legs, 0 if routing failed.
+    /// </summary>
+    public int legCount {
+        get { return m_legs.Length; }
+    }
+
+    /// <summary>
+    /// Total length of the route in meters.
+    /// </summary>
+    public double length {
+        get { return (m_legEnd.Length > 0 ? m_legEnd[m_legEnd.Length - 1] : 0.0); }
+    }
+
+    /// <summary>
+    /// Number of per-floor segments.
+    /// </summary>
+    public int floorSegmentCount {
+        get { return m_segments.Length; }
+    }
+
+    /// <summary>
+    /// Number of turns, see <c>GetTurnLeg</c>.
+    /// </summary>
+    public int turnCount {
+        get { return m_turns.Length; }
+    }
+
+    RouteSnapshot(Route route) {
+        this.route = route;
+        int count = (route.isSuccessful && route.legs != null ? route.legs.Length : 0);
+        m_legs = new RouteLegData[count];
+        m_legEnd = new double[count];
+        m_points = new Vector2[2 * count];
+        if (count == 0) {
+            m_segments = new RouteFloorSegment[0];
+            m_turns = new int[0];
+            return;
+        }
+
+        RouteLegData.FromRoute(route, ref m_legs);
+        m_conversion.SetOrigin(m_legs[0].begin.latitude, m_legs[0].begin.longitude);
+        int segments = 1, turns = 0;
+        double distance = 0.0;
+        for (int i = 0; i < count; ++i) {
+            distance += m_legs[i].length;
+            m_legEnd[i] = distance;
+            m_points[2 * i] = m_conversion.WGStoEN(m_legs[i].begin.latitude, m_legs[i].begin.longitude);
+            m_points[2 * i + 1] = m_conversion.WGStoEN(m_legs[i].end.latitude, m_legs[i].end.longitude);
+            if (i == 0) continue;
+            if (m_legs[i].begin.floor != m_legs[i - 1].begin.floor) ++segments;
+            if (IsTurn(i)) ++turns;
+        }
+
+        m_segments = new RouteFloorSegment[segments];
+        m_turns = new int[turns];
+        int s = 0, t = 0;
+        m_segments[0] = new RouteFloorSegment { floor = m_legs[0].begin.floor };
+        for (int i = 0; i < count; ++i) {
+            if (i > 0 && m_legs[i].begin.floor != m_segments[s].floor) {
+                m_segments[++s] = new RouteFloorSegment { floor = m_legs[i].begin.floor, firstLeg = i, startDistance = m_legEnd[i - 1] };
+            }
+            m_segments[s].legCount++;
+            m_segments[s].length += m_legs[i].length;
+            if (i > 0 && IsTurn(i)) m_turns[t++] = i;
+        }
+    }
+
+    // Whether the user turns or changes floor when entering leg i
+    bool IsTurn(int i) {
+        if (m_legs[i].begin.floor != m_legs[i].end.floor || m_legs[i - 1].begin.floor != m_legs[i - 1].end.floor) return true;
+        double delta = Math.Abs(m_legs[i].direction - m_legs[i - 1].direction) % 360.0;
+        return Math.Min(delta, 360.0 - delta) >= TurnAngle;
+    }
+
+    internal static RouteSnapshot Parse(string json) {
+        return new RouteSnapshot(JsonUtility.FromJson<Route>(json));
+    }
+
+    /// <summary>
+    /// Returns the leg at index.
+    /// </summary>
+    public RouteLegData GetLeg(int index) {
+        return m_legs[index];
+    }
+
+    /// <summary>
+    /// Copies the legs to legs, which is grown if too small, and returns the number of legs.
+    /// </summary>
+    public int GetLegs(ref RouteLegData[] legs) {
+        if (legs == null || legs.Length < m_legs.Length) legs = new RouteLegData[m_legs.Length];
+        Array.Copy(m_legs, legs, m_legs.Length);
+        return m_legs.Length;
+    }
+
+    /// <summary>
+    /// Returns the distance in meters from the start of the route to the end of the leg at index.
+    /// </summary>
+    public double GetDistanceToLegEnd(int index) {
+        return m_legEnd[index];
+    }
+
+    /// <summary>
+    /// Returns the per-floor segment at index, segments are in route order.
+    /// </summary>
+    public RouteFloorSegment GetFloorSegment(int index) {
+        return m_segments[index];
+    }
+
+    /// <summary>
+    /// Returns the index of the leg entered at the turn at index. Turns are heading changes of 30 degrees
+    /// or more between consecutive legs and floor changes, in route order.
+    /// </summary>
+    public int GetTurnLeg(int index) {
+        return m_turns[index];
+    }
+
+    /// <summary>
+    /// Returns the first turn entering a leg after the given leg, or -1 if there are no more turns.
+    /// </summary>
+    public int GetNextTurn(int leg) {
+        int lo = 0, hi = m_turns.Length;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (m_turns[mid] <= leg) lo = mid + 1;
+            else hi = mid;
+        }
+        return (lo < m_turns.Length ? lo : -1);
+    }
+
+    /// <summary>
+    /// Finds the closest point of the route on the given floor to the location.
+    /// </summary>
+    /// <param name="leg">Index of the closest leg</param>
+    /// <param name="distance">Distance in meters from the start of the route to the closest point</param>
+    /// <returns>False if no leg touches the floor</returns>
+    public bool Locate(double latitude, double longitude, int floor, out int leg, out double distance) {
+        leg = -1;
+        distance = 0.0;
+        if (m_legs.Length == 0) return false;
+        Vector2 p = m_conversion.WGStoEN(latitude, longitude);
+        float best = float.MaxValue;
+        for (int i = 0; i < m_legs.Length; ++i) {
+            if (m_legs[i].begin.floor != floor && m_legs[i].end.floor != floor) continue;
+            Vector2 a = m_points[2 * i], ab = m_points[2 * i + 1] - a;
+            float sq = ab.sqrMagnitude;
+            float t = (sq > 0 ? Mathf.Clamp01(Vector2.Dot(p - a, ab) / sq) : 0);
+            float d = (a + t * ab - p).sqrMagnitude;
+            if (d < best) {
+                best = d;
+                leg = i;
+                distance = m_legEnd[i] - (1.0 - t) * m_legs[i].length;
+            }
+        }
+        return leg >= 0;
+    }
+}
+
+/// <summary>
+/// Parses route events sent by the native side and derives the <c>RouteSnapshot</c> data on a background
+/// thread, so that re-routing does not cost main thread time. Only the newest pending route is processed
+/// when the SDK re-routes faster than the routes are built.
+/// </summary>
+internal sealed class RouteCache : IDisposable {
+    readonly object m_lock = new object();
+    readonly Thread m_thread;
+    string m_pending = null;
+    RouteSnapshot m_ready = null;
+    bool m_stop = false;
+
+    public RouteCache() {
+        m_thread = new Thread(Run) { Name = "IndoorAtlas routes", IsBackground = true };
+        m_thread.Start();
+    }
+
+    // Queues route JSON, replacing any route that was not processed yet
+    public void Submit(string json) {
+        lock (m_lock) {
+            m_pending = json;
+            Monitor.Pulse(m_lock);
+        }
+    }
+
+    // Returns the route built since the last call, or null
+    public RouteSnapshot Take() {
+        lock (m_lock) {
+            RouteSnapshot ready = m_ready;
+            m_ready = null;
+            return ready;
+        }
+    }
+
+    void Run() {
+        for (;;) {
+            string json;
+            lock (m_lock) {
+                while (m_pending == null && !m_stop) Monitor.Wait(m_lock);
+                if (m_stop) return;
+                json = m_pending;
+                m_pending = null;
+            }
+            RouteSnapshot snapshot;
+            try {
+                snapshot = RouteSnapshot.Parse(json);
+            } catch (Exception e) {
+                Debug.LogException(e);
+                continue;
+            }
+            lock (m_lock) {
+                // a newer route arrived meanwhile, it replaces this one
+                if (m_pending == null) m_ready = snapshot;
+            }
+        }
+    }
+
+    public void Dispose() {
+        lock (m_lock) {
+            if (m_stop) return;
+            m_stop = true;
+            Monitor.Pulse(m_lock);
+        }
+        m_thread.Join();
+    }
+}
+
+}
@@ -1,12 +1,89 @@
 using UnityEngine;
+using Unity.Profiling;
 
 namespace IndoorAtlas {
 
+// Typed event handlers of IndoorAtlasSession.
+// Location, Heading and Status objects of binary events are reused, copy them if you need to keep them around.
+public delegate void LocationHandler(Location location);
+public delegate void LocationDataHandler(in LocationData location);
+public delegate void HeadingHandler(Heading heading);
+public delegate void HeadingDataHandler(in HeadingData heading);
+public delegate void OrientationHandler(in Quaternion orientation);
+public delegate void OrientationDataHandler(in OrientationData orientation);
+public delegate void StatusHandler(Status status);
+public delegate void RegionHandler(Region region);
+public delegate void RouteHandler(Route route);
+public delegate void ExtraInfoHandler(ExtraInfo info);
+
 [DisallowMultipleComponent]
 [DefaultExecutionOrder(-1)]
 [AddComponentMenu("IndoorAtlas/IndoorAtlas Session")]
 public class IndoorAtlasSession : MonoBehaviour {
     LocationManager manager = null;
+    EventBuffer events = null;
+    EventRecord record;
+
+    // Reused for binary events, receivers must copy these if they want to keep them around
+    IndoorAtlas.Location location = new IndoorAtlas.Location { position = new LatLngFloor { coordinate = new WGS84() } };
+    IndoorAtlas.Heading heading = new IndoorAtlas.Heading();
+    IndoorAtlas.Status status = new IndoorAtlas.Status();
+
+    // Profiler markers of the event paths, visible in the Unity profiler and in IndoorAtlasBenchmark results
+    static readonly ProfilerMarker s_drainEventsMarker = new ProfilerMarker("IndoorAtlas.DrainEvents");
+    static readonly ProfilerMarker s_onLocationChangedMarker = new ProfilerMarker("IndoorAtlas.OnLocationChanged");
+    static readonly ProfilerMarker s_onStatusChangedMarker = new ProfilerMarker("IndoorAtlas.OnStatusChanged");
+    static readonly ProfilerMarker s_onHeadingChangedMarker = new ProfilerMarker("IndoorAtlas.OnHeadingChanged");
+    static readonly ProfilerMarker s_onOrientationChangedMarker = new ProfilerMarker("IndoorAtlas.OnOrientationChanged");
+    static readonly ProfilerMarker s_onEnterRegionMarker = new ProfilerMarker("IndoorAtlas.OnEnterRegion");
+    static readonly ProfilerMarker s_onExitRegionMarker = new ProfilerMarker("IndoorAtlas.OnExitRegion");
+    static readonly ProfilerMarker s_onRouteMarker = new ProfilerMarker("IndoorAtlas.OnRoute");
+    static readonly ProfilerMarker s_onExtraInfoMarker = new ProfilerMarker("IndoorAtlas.OnExtraInfo");
+
+    /// <summary>
+    /// Invoked on every location update.
+    /// </summary>
+    public event LocationHandler locationChanged;
+    /// <summary>
+    /// Invoked on every location update with the blittable location, without allocations on the binary transport.
+    /// </summary>
+    public event LocationDataHandler locationDataChanged;
+    /// <summary>
+    /// Invoked on every heading update.
+    /// </summary>
+    public event HeadingHandler headingChanged;
+    /// <summary>
+    /// Invoked on every heading update with the blittable heading.
+    /// </summary>
+    public event HeadingDataHandler headingDataChanged;
+    /// <summary>
+    /// Invoked on every orientation update with the device orientation in Unity coordinates.
+    /// </summary>
+    public event OrientationHandler orientationChanged;
+    /// <summary>
+    /// Invoked on every orientation update with the timestamped orientation in IndoorAtlas coordinates.
+    /// </summary>
+    public event OrientationDataHandler orientationDataChanged;
+    /// <summary>
+    /// Invoked when the positioning service status changes.
+    /// </summary>
+    public event StatusHandler statusChanged;
+    /// <summary>
+    /// Invoked when a region (venue, floor plan, geofence) is entered.
+    /// </summary>
+    public event RegionHandler enteredRegion;
+    /// <summary>
+    /// Invoked when a region (venue, floor plan, geofence) is exited.
+    /// </summary>
+    public event RegionHandler exitedRegion;
+    /// <summary>
+    /// Invoked on wayfinding route updates.
+    /// </summary>
+    public event RouteHandler routeUpdated;
+    /// <summary>
+    /// Invoked when the SDK extra info, such as the trace ID, changes.
+    /// </summary>
+    public event ExtraInfoHandler extraInfoChanged;
 
     [Header("IndoorAtlas API credentials")]
 
@@ -32,6 +109,7 @@ public class IndoorAtlasSession : MonoBehaviour {
     {
         get { return m_distanceFilter; }
         set {
+            if (value == m_distanceFilter) return;
             m_distanceFilter = value;
             if (manager != null) manager.SetDistanceFilter(value);
         }
@@ -45,6 +123,7 @@ public class IndoorAtlasSession : MonoBehaviour {
     {
         get { return m_timeFilter; }
         set {
+            if (value == m_timeFilter) return;
             m_timeFilter = value;
             if (manager != null) manager.SetTimeFilter(value);
         }
@@ -58,6 +137,7 @@ public class IndoorAtlasSession : MonoBehaviour {
     {
         get { return m_headingFilter; }
         set {
+            if (value == m_headingFilter) return;
             m_headingFilter = value;
             if (manager != null) manager.SetHeadingFilter(value);
         }
@@ -71,11 +151,236 @@ public class IndoorAtlasSession : MonoBehaviour {
     {
         get { return m_attitudeFilter; }
         set {
+            if (value == m_attitudeFilter) return;
             m_attitudeFilter = value;
             if (manager != null) manager.SetAttitudeFilter(value);
         }
     }
 
+    [SerializeField]
+    [Tooltip("How location, heading and orientation events are delivered from the native SDK. Json is slower and allocates for each event.")]
+    EventTransport m_eventTransport = EventTransport.Binary;
+
+    public EventTransport eventTransport
+    {
+        get { return m_eventTransport; }
+        set {
+            m_eventTransport = value;
+            if (manager != null) manager.SetEventTransport(value);
+        }
+    }
+
+    [SerializeField]
+    [Tooltip("Binary event types for which only the latest event is delivered each frame, older ones are dropped instead of queued.")]
+    EventTypeMask m_keepLatest = EventTypeMask.Heading | EventTypeMask.Orientation;
+
+    public EventTypeMask keepLatest
+    {
+        get { return m_keepLatest; }
+        set {
+            m_keepLatest = value;
+            if (events != null) events.keepLatest = value;
+        }
+    }
+
+    [SerializeField]
+    [Tooltip("Maximum heading events per second delivered from the native SDK, faster samples are coalesced to the latest one (0 for no limit).")]
+    double m_headingMaxRate = 60.0;
+
+    public double headingMaxRate
+    {
+        get { return m_headingMaxRate; }
+        set {
+            m_headingMaxRate = value;
+            if (manager != null) manager.SetEventRateLimit(EventType.Heading, value);
+        }
+    }
+
+    [SerializeField]
+    [Tooltip("Maximum orientation events per second delivered from the native SDK, faster samples are coalesced to the latest one (0 for no limit).")]
+    double m_orientationMaxRate = 60.0;
+
+    public double orientationMaxRate
+    {
+        get { return m_orientationMaxRate; }
+        set {
+            m_orientationMaxRate = value;
+            if (manager != null) manager.SetEventRateLimit(EventType.Orientation, value);
+        }
+    }
+
+    [SerializeField]
+    [Tooltip("Also deliver events to IndoorAtlasOn* methods of child components with BroadcastMessage, for scripts written before the typed events.")]
+    bool m_broadcastMessages = true;
+
+    /// <summary>
+    /// Also deliver events to <c>IndoorAtlasOn*</c> methods of child components with <c>BroadcastMessage</c>.
+    /// This walks the child hierarchy with reflection on every event, turn it off once all receivers
+    /// subscribe to the typed events instead.
+    /// </summary>
+    public bool broadcastMessages
+    {
+        get { return m_broadcastMessages; }
+        set { m_broadcastMessages = value; }
+    }
+
+    // Class receivers need the Location object, the binary path skips filling it when there are none
+    bool wantsLocationObject {
+        get { return locationChanged != null || m_broadcastMessages; }
+    }
+
+    void Emit(LocationHandler handler, string message, Location location) {
+        if (handler != null) handler(location);
+        if (m_broadcastMessages) BroadcastMessage(message, location, SendMessageOptions.DontRequireReceiver);
+    }
+
+    void EmitLocationData(in LocationData data) {
+        if (manager != null) manager.UpdateRouteProgress(in data);
+        if (locationDataChanged != null) locationDataChanged(in data);
+    }
+
+    void EmitHeadingData(in HeadingData data) {
+        if (headingDataChanged != null) headingDataChanged(in data);
+    }
+
+    void Emit(RegionHandler handler, string message, Region region) {
+        if (handler != null) handler(region);
+        if (m_broadcastMessages) BroadcastMessage(message, region, SendMessageOptions.DontRequireReceiver);
+    }
+
+    void EmitHeading(Heading heading) {
+        if (headingChanged != null) headingChanged(heading);
+        if (m_broadcastMessages) BroadcastMessage("IndoorAtlasOnHeadingChanged", heading, SendMessageOptions.DontRequireReceiver);
+    }
+
+    // Converts to Unity coordinates only when someone receives the quaternion
+    void EmitOrientationData(in OrientationData data) {
+        if (orientationDataChanged != null) orientationDataChanged(in data);
+        if (orientationChanged == null && !m_broadcastMessages) return;
+        Quaternion unityRot = data.ToUnity();
+        EmitOrientation(in unityRot);
+    }
+
+    void EmitOrientation(in Quaternion orientation) {
+        if (orientationChanged != null) orientationChanged(in orientation);
+        if (m_broadcastMessages) BroadcastMessage("IndoorAtlasOnOrientationChanged", orientation, SendMessageOptions.DontRequireReceiver);
+    }
+
+    void EmitStatus(Status status) {
+        if (statusChanged != null) statusChanged(status);
+        if (m_broadcastMessages) BroadcastMessage("IndoorAtlasOnStatusChanged", status, SendMessageOptions.DontRequireReceiver);
+    }
+
+    void EmitRoute(Route route) {
+        if (routeUpdated != null) routeUpdated(route);
+        if (m_broadcastMessages) BroadcastMessage("IndoorAtlasOnRoute", route, SendMessageOptions.DontRequireReceiver);
+    }
+
+    void EmitExtraInfo(ExtraInfo info) {
+        if (extraInfoChanged != null) extraInfoChanged(info);
+        if (m_broadcastMessages) BroadcastMessage("IndoorAtlasOnExtraInfo", info, SendMessageOptions.DontRequireReceiver);
+    }
+
+    [Header("Recording")]
+
+    [SerializeField]
+    [Tooltip("Record every event received by the session and the AR matrices to a binary trace file.")]
+    bool m_record = false;
+
+    /// <summary>
+    /// Record every event received by the session and the AR matrices to a binary trace file,
+    /// which can be replayed with <c>replayTrace</c>. Can be toggled while the session is enabled.
+    /// </summary>
+    public bool recording
+    {
+        get { return m_record; }
+        set {
+            if (m_record == value) return;
+            m_record = value;
+            if (manager == null) return;
+            if (value) StartRecording();
+            else StopRecording();
+        }
+    }
+
+    [SerializeField]
+    [Tooltip("Path of the trace file, blank for a timestamped file in Application.persistentDataPath.")]
+    string m_recordPath = "";
+
+    /// <summary>
+    /// Path of the trace file, blank for a timestamped file in <c>Application.persistentDataPath</c>.
+    /// </summary>
+    public string recordPath
+    {
+        get { return m_recordPath; }
+        set { m_recordPath = value; }
+    }
+
+    SessionRecorder recorder = null;
+
+    /// <summary>
+    /// The active recorder, or null if not recording.
+    /// </summary>
+    public SessionRecorder activeRecorder
+    {
+        get { return recorder; }
+    }
+
+    void StartRecording() {
+        string path = m_recordPath;
+        if (string.IsNullOrEmpty(path)) {
+            path = System.IO.Path.Combine(Application.persistentDataPath,
+                    "indooratlas-" + System.DateTime.UtcNow.ToString("yyyyMMdd-HHmmss") + ".iatrace");
+        }
+        recorder = new SessionRecorder(path);
+        manager.SetRecorder(recorder);
+        // extra info is only sent when the positioning session starts, which may be before recording
+        ExtraInfo info = manager.GetExtraInfo();
+        if (!string.IsNullOrEmpty(info.traceId)) recorder.RecordText(TraceRecordKind.ExtraInfo, JsonUtility.ToJson(info));
+#if DEVELOPMENT_BUILD
+        Debug.Log("IndoorAtlas: recording to " + path);
+#endif
+    }
+
+    void StopRecording() {
+        if (recorder == null) return;
+        manager.SetRecorder(null);
+        recorder.Dispose();
+        recorder = null;
+    }
+
+    [Header("Replay (editor and desktop only)")]
+
+    [SerializeField]
+    [Tooltip("Trace file replayed instead of the IndoorAtlas SDK on platforms other than iOS and Android, blank for none.")]
+    string m_replayTrace = "";
+
+    /// <summary>
+    /// Trace file replayed instead of the IndoorAtlas SDK on platforms other than iOS and Android, blank for none.
+    /// See <c>IndoorAtlasReplay</c> for the format. Takes effect when the session is enabled.
+    /// </summary>
+    public string replayTrace
+    {
+        get { return m_replayTrace; }
+        set { m_replayTrace = value; }
+    }
+
+    [SerializeField]
+    [Tooltip("Replay speed multiplier, 1 replays the trace in real time.")]
+    float m_replaySpeed = 1.0f;
+
+    /// <summary>
+    /// Replay speed multiplier, 1 replays the trace in real time.
+    /// </summary>
+    public float replaySpeed
+    {
+        get { return m_replaySpeed; }
+        set {
+            m_replaySpeed = value;
+            if (manager != null && manager.GetReplay()) manager.GetReplay().speed = value;
+        }
+    }
+
     void WarnIfMultipleSessions() {
         var sessions = FindObjectsOfType<IndoorAtlasSession>();
         if (sessions.Length > 1) {
@@ -98,77 +403,200 @@ public class IndoorAtlasSession : MonoBehaviour {
         WarnIfMultipleSessions();
 #endif
         manager = new LocationManager();
+        manager.SetReplay(m_replayTrace, m_replaySpeed);
         manager.Init(apiKey, apiSecret, apiEndpoint, name);
         manager.SetDistanceFilter(m_distanceFilter);
         manager.SetTimeFilter(m_timeFilter);
         manager.SetHeadingFilter(m_headingFilter);
         manager.SetAttitudeFilter(m_attitudeFilter);
+        manager.SetEventTransport(m_eventTransport);
+        manager.SetEventRateLimit(EventType.Heading, m_headingMaxRate);
+        manager.SetEventRateLimit(EventType.Orientation, m_orientationMaxRate);
+        events = manager.GetEventBuffer();
+        if (events != null) events.keepLatest = m_keepLatest;
+        if (m_record) StartRecording();
         manager.StartUpdatingLocation();
     }
 
     void OnDisable() {
         if (manager == null) return;
         manager.StopUpdatingLocation();
+        StopRecording();
         manager.Close();
         manager = null;
+        events = null;
+    }
+
+    void DispatchEvent(ref EventRecord record) {
+        if (recorder != null) recorder.Record(ref record);
+        switch (record.type) {
+            case EventType.Location:
+                LocationData locationData = LocationData.FromRecord(ref record);
+                EmitLocationData(in locationData);
+                if (wantsLocationObject) Emit(locationChanged, "IndoorAtlasOnLocationChanged", locationData.ToLocation(location));
+                break;
+            case EventType.Heading:
+                HeadingData headingData = new HeadingData { heading = record.v0, timestamp = record.timestamp };
+                EmitHeadingData(in headingData);
+                EmitHeading(headingData.ToHeading(heading));
+                break;
+            case EventType.Orientation:
+                OrientationData orientationData = new OrientationData {
+                    x = record.v0, y = record.v1, z = record.v2, w = record.v3, timestamp = record.timestamp };
+                EmitOrientationData(in orientationData);
+                break;
+            case EventType.Status:
+                status.status = (Status.ServiceStatus)record.code;
+                EmitStatus(status);
+                break;
+        }
+    }
+
+    void Update() {
+        if (manager != null) {
+            RouteSnapshot route = manager.TakeRoute();
+            if (route != null) EmitRoute(route.route);
+        }
+
+        using (s_drainEventsMarker.Auto()) {
+            if (events == null || m_eventTransport != EventTransport.Binary) return;
+
+            // Drain only what was queued when the frame started, anything pushed meanwhile waits for the next frame
+            int pending = events.Pending();
+            for (int i = 0; i < pending; ++i) {
+                events.ReadQueued(i, ref record);
+                DispatchEvent(ref record);
+            }
+            events.Consume(pending);
+
+            for (EventType type = EventType.Location; type <= EventType.Status; ++type) {
+                if ((m_keepLatest & (EventTypeMask)(1 << (int)type)) == 0) continue;
+                if (events.ReadLatest(type, ref record)) DispatchEvent(ref record);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Number of events of the given type that were dropped, either because the native side coalesced them
+    /// to the rate limit, because the event ring was full or because the type is in <c>keepLatest</c>
+    /// and a newer event replaced it within a frame.
+    /// </summary>
+    public int GetDroppedEventCount(EventType type) {
+        return (events != null ? events.GetDroppedCount(type) : 0);
     }
 
     void NativeIndoorAtlasOnLocationChanged(string data) {
+        using (s_onLocationChangedMarker.Auto()) {
 #if DEVELOPMENT_BUILD
-        Debug.Log("IndoorAtlas: IndoorAtlasOnLocationChanged()");
+            Debug.Log("IndoorAtlas: IndoorAtlasOnLocationChanged()");
 #endif
-        IndoorAtlas.Location location = JsonUtility.FromJson<IndoorAtlas.Location>(data);
-        BroadcastMessage("IndoorAtlasOnLocationChanged", location, SendMessageOptions.DontRequireReceiver);
+            IndoorAtlas.Location location = JsonUtility.FromJson<IndoorAtlas.Location>(data);
+            if (recorder != null) {
+                EventRecord evt = new EventRecord { type = EventType.Location, timestamp = location.timestamp, floor = location.position.floor,
+                    v0 = location.position.coordinate.latitude, v1 = location.position.coordinate.longitude,
+                    v2 = location.accuracy, v3 = location.altitude, v4 = location.bearing };
+                recorder.Record(ref evt);
+            }
+            LocationData locationData = LocationData.FromLocation(location);
+            EmitLocationData(in locationData);
+            Emit(locationChanged, "IndoorAtlasOnLocationChanged", location);
+        }
     }
 
     void NativeIndoorAtlasOnStatusChanged(string data) {
+        using (s_onStatusChangedMarker.Auto()) {
 #if DEVELOPMENT_BUILD
-        Debug.Log("IndoorAtlas: IndoorAtlasOnStatusChanged()");
+            Debug.Log("IndoorAtlas: IndoorAtlasOnStatusChanged()");
 #endif
-        IndoorAtlas.Status serviceStatus = JsonUtility.FromJson<IndoorAtlas.Status> (data);
-        BroadcastMessage("IndoorAtlasOnStatusChanged", serviceStatus, SendMessageOptions.DontRequireReceiver);
+            IndoorAtlas.Status serviceStatus = JsonUtility.FromJson<IndoorAtlas.Status> (data);
+            if (recorder != null) {
+                EventRecord evt = new EventRecord { type = EventType.Status, code = (int)serviceStatus.status };
+                recorder.Record(ref evt);
+            }
+            EmitStatus(serviceStatus);
+        }
     }
 
     void NativeIndoorAtlasOnHeadingChanged(string data) {
+        using (s_onHeadingChangedMarker.Auto()) {
 #if DEVELOPMENT_BUILD
-        Debug.Log("IndoorAtlas: IndoorAtlasOnHeadingChanged()");
+            Debug.Log("IndoorAtlas: IndoorAtlasOnHeadingChanged()");
 #endif
-        IndoorAtlas.Heading heading = JsonUtility.FromJson<IndoorAtlas.Heading>(data);
-        BroadcastMessage("IndoorAtlasOnHeadingChanged", heading, SendMessageOptions.DontRequireReceiver);
+            IndoorAtlas.Heading heading = JsonUtility.FromJson<IndoorAtlas.Heading>(data);
+            if (recorder != null) {
+                EventRecord evt = new EventRecord { type = EventType.Heading, timestamp = heading.timestamp, v0 = heading.heading };
+                recorder.Record(ref evt);
+            }
+            HeadingData headingData = HeadingData.FromHeading(heading);
+            EmitHeadingData(in headingData);
+            EmitHeading(heading);
+        }
     }
 
     void NativeIndoorAtlasOnOrientationChanged(string data) {
+        using (s_onOrientationChangedMarker.Auto()) {
 #if DEVELOPMENT_BUILD
-        Debug.Log("IndoorAtlas: IndoorAtlasOnOrientationChanged()");
+            Debug.Log("IndoorAtlas: IndoorAtlasOnOrientationChanged()");
 #endif
-        Quaternion orientation = JsonUtility.FromJson<IndoorAtlas.Orientation>(data).getQuaternion();
-        Quaternion rot = Quaternion.Inverse(new Quaternion(orientation.x, orientation.y, -orientation.z, orientation.w));
-        Quaternion unityRot = Quaternion.Euler(new Vector3(90.0f, 0.0f, 0.0f)) * rot;
-        BroadcastMessage("IndoorAtlasOnOrientationChanged", unityRot, SendMessageOptions.DontRequireReceiver);
+            IndoorAtlas.Orientation orientation = JsonUtility.FromJson<IndoorAtlas.Orientation>(data);
+            if (recorder != null) {
+                EventRecord evt = new EventRecord { type = EventType.Orientation, timestamp = orientation.timestamp,
+                    v0 = orientation.x, v1 = orientation.y, v2 = orientation.z, v3 = orientation.w };
+                recorder.Record(ref evt);
+            }
+            OrientationData orientationData = OrientationData.FromOrientation(orientation);
+            EmitOrientationData(in orientationData);
+        }
     }
 
     void NativeIndoorAtlasOnEnterRegion(string data) {
+        using (s_onEnterRegionMarker.Auto()) {
 #if DEVELOPMENT_BUILD
-        Debug.Log("IndoorAtlas: IndoorAtlasOnEnterRegion()");
+            Debug.Log("IndoorAtlas: IndoorAtlasOnEnterRegion()");
 #endif
-        IndoorAtlas.Region region = JsonUtility.FromJson<IndoorAtlas.Region>(data);
-        BroadcastMessage("IndoorAtlasOnEnterRegion", region, SendMessageOptions.DontRequireReceiver);
+            // the venue cache lives in the manager, a late event after Dispose has nothing to resolve against
+            if (manager == null) return;
+            IndoorAtlas.Region region = manager.ParseRegion(data);
+            if (recorder != null) recorder.RecordRegion(TraceRecordKind.EnterRegion, data, region);
+            Emit(enteredRegion, "IndoorAtlasOnEnterRegion", region);
+        }
     }
 
     void NativeIndoorAtlasOnExitRegion(string data) {
+        using (s_onExitRegionMarker.Auto()) {
 #if DEVELOPMENT_BUILD
-        Debug.Log("IndoorAtlas: IndoorAtlasOnExitRegion()");
+            Debug.Log("IndoorAtlas: IndoorAtlasOnExitRegion()");
 #endif
-        IndoorAtlas.Region region = JsonUtility.FromJson<IndoorAtlas.Region>(data);
-        BroadcastMessage("IndoorAtlasOnExitRegion", region, SendMessageOptions.DontRequireReceiver);
+            // the venue cache lives in the manager, a late event after Dispose has nothing to resolve against
+            if (manager == null) return;
+            IndoorAtlas.Region region = manager.ParseRegion(data);
+            if (recorder != null) recorder.RecordRegion(TraceRecordKind.ExitRegion, data, region);
+            Emit(exitedRegion, "IndoorAtlasOnExitRegion", region);
+        }
     }
 
     void NativeIndoorAtlasOnRoute(string data) {
+        using (s_onRouteMarker.Auto()) {
 #if DEVELOPMENT_BUILD
-        Debug.Log("IndoorAtlas: IndoorAtlasOnRoute()");
+            Debug.Log("IndoorAtlas: IndoorAtlasOnRoute()");
 #endif
-        IndoorAtlas.Route route = JsonUtility.FromJson<IndoorAtlas.Route>(data);
-        BroadcastMessage("IndoorAtlasOnRoute", route, SendMessageOptions.DontRequireReceiver);
+            if (recorder != null) recorder.RecordText(TraceRecordKind.Route, data);
+            // parsed on a background thread, routeUpdated is invoked from Update once it is ready
+            if (manager != null) manager.SubmitRoute(data);
+        }
+    }
+
+    void NativeIndoorAtlasOnExtraInfo(string data) {
+        using (s_onExtraInfoMarker.Auto()) {
+#if DEVELOPMENT_BUILD
+            Debug.Log("IndoorAtlas: IndoorAtlasOnExtraInfo()");
+#endif
+            if (manager == null) return;
+            IndoorAtlas.ExtraInfo info = manager.ParseExtraInfo(data);
+            if (info == null) return;
+            if (recorder != null) recorder.RecordText(TraceRecordKind.ExtraInfo, data);
+            EmitExtraInfo(info);
+        }
     }
 }
 
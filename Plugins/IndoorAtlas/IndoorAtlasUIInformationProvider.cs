@@ -8,6 +8,7 @@ namespace IndoorAtlas {
 [AddComponentMenu("IndoorAtlas/IndoorAtlas UI Information Provider")]
 public class IndoorAtlasUIInformationProvider : MonoBehaviour {
     LocationManager manager = null;
+    IndoorAtlasSession session = null;
     Region currentVenue = null;
     UnityAction<int> poiAction = null;
 
@@ -84,7 +85,7 @@ public class IndoorAtlasUIInformationProvider : MonoBehaviour {
         }
     }
 
-    void IndoorAtlasOnEnterRegion(Region region) {
+    void OnEnterRegion(Region region) {
         if (m_region) m_region.text = region.name;
         if (region.type == Region.Type.Venue) {
             currentVenue = region;
@@ -97,7 +98,7 @@ public class IndoorAtlasUIInformationProvider : MonoBehaviour {
         }
     }
 
-    void IndoorAtlasOnExitRegion(Region region) {
+    void OnExitRegion(Region region) {
         if (region.type == Region.Type.FloorPlan && currentVenue != null) {
             if (m_region) m_region.text = currentVenue.name;
         } else if (region.type == Region.Type.Venue) {
@@ -110,8 +111,8 @@ public class IndoorAtlasUIInformationProvider : MonoBehaviour {
         }
     }
 
-    void UpdateText() {
-        if (m_traceId) m_traceId.text = manager.GetTraceId();
+    void OnExtraInfoChanged(ExtraInfo info) {
+        if (m_traceId) m_traceId.text = info.traceId;
     }
 
     void Awake() {
@@ -127,11 +128,22 @@ public class IndoorAtlasUIInformationProvider : MonoBehaviour {
 
     void OnEnable() {
         manager = new LocationManager();
-        if (m_traceId) InvokeRepeating("UpdateText", 0.0f, 1.0f);
+        session = GetComponentInParent<IndoorAtlasSession>();
+        if (session) {
+            session.enteredRegion += OnEnterRegion;
+            session.exitedRegion += OnExitRegion;
+            session.extraInfoChanged += OnExtraInfoChanged;
+        }
+        if (m_traceId) m_traceId.text = manager.GetTraceId();
     }
 
     void OnDisable() {
-        CancelInvoke();
+        if (session) {
+            session.enteredRegion -= OnEnterRegion;
+            session.exitedRegion -= OnExitRegion;
+            session.extraInfoChanged -= OnExtraInfoChanged;
+        }
+        session = null;
         manager = null;
     }
 }
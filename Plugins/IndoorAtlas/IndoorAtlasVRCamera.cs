@@ -1,18 +1,158 @@
-﻿using UnityEngine;
+﻿using System;
+using System.Diagnostics;
+using UnityEngine;
 
 namespace IndoorAtlas {
 
+/// <summary>
+/// Rotates the camera with the device orientation of the parent <c>IndoorAtlasSession</c>.
+/// Orientation samples are buffered and the camera is updated right before every rendered frame,
+/// interpolating between the samples at the current time minus <c>interpolationDelay</c>.
+/// Sample timestamps are mapped to the local clock with an offset estimated from their delivery times,
+/// so they need not be UTC. When the target time is past the newest sample, the rotation is extrapolated
+/// from the two newest samples, by at most the measured <c>latency</c> and <c>maxExtrapolation</c>, and only
+/// while samples keep arriving: when the attitude filter stops them, the camera settles on the newest one.
+/// This keeps the view moving at display rate instead of at the rate the orientation events are delivered.
+/// </summary>
 [RequireComponent(typeof(Camera))]
 [AddComponentMenu("IndoorAtlas/IndoorAtlas VR Camera")]
 public class IndoorAtlasVRCamera : MonoBehaviour {
     Camera m_camera;
+    IndoorAtlasSession m_session;
+
+    [SerializeField]
+    [Tooltip("Seconds the camera lags behind the current time, more than the interval between orientation events interpolates instead of extrapolating.")]
+    float m_interpolationDelay = 0.0f;
+
+    /// <summary>
+    /// Seconds the camera lags behind the current time. Values larger than the interval between orientation
+    /// events interpolate between received samples instead of extrapolating, trading latency for smoothness.
+    /// </summary>
+    public float interpolationDelay
+    {
+        get { return m_interpolationDelay; }
+        set { m_interpolationDelay = value; }
+    }
+
+    [SerializeField]
+    [Tooltip("Maximum number of seconds the rotation is extrapolated past the newest orientation sample, the measured latency is used if smaller.")]
+    float m_maxExtrapolation = 0.1f;
+
+    /// <summary>
+    /// Maximum number of seconds the rotation is extrapolated past the newest orientation sample.
+    /// The extrapolation is further limited to the measured <c>latency</c>.
+    /// </summary>
+    public float maxExtrapolation
+    {
+        get { return m_maxExtrapolation; }
+        set { m_maxExtrapolation = value; }
+    }
+
+    /// <summary>
+    /// Smoothed delay in seconds of delivering an orientation sample, beyond the shortest delay observed.
+    /// The sample clock is not synchronized with the local one, so the constant part of the delay is unknown.
+    /// </summary>
+    public float latency { get; private set; }
+
+    // Weight of the newest sample in the smoothed latency and sample interval
+    const float LatencySmoothing = 0.1f;
+    // Fraction of the difference by which the clock offset follows a longer delivery delay, so that
+    // it tracks drift between the clocks while still converging on the shortest delay
+    const double OffsetDrift = 0.01;
+    // Samples are considered to have stopped when none arrived for this many sample intervals
+    const float StaleIntervals = 2.0f;
+    const int Capacity = 8;
+
+    // Ring buffer of the latest samples in IndoorAtlas coordinates, converted to Unity coordinates once per frame
+    readonly Quaternion[] m_rotations = new Quaternion[Capacity];
+    readonly long[] m_timestamps = new long[Capacity];
+    int m_newest = -1;
+    int m_count = 0;
+    // Local time minus sample timestamp of the fastest recent delivery, in milliseconds
+    double m_clockOffset;
+    double m_lastArrival;
+    float m_interval;
+
+    static readonly Stopwatch s_clock = Stopwatch.StartNew();
+
+    static double NowMilliseconds() {
+        return s_clock.Elapsed.TotalMilliseconds;
+    }
 
     void Awake() {
         m_camera = GetComponent<Camera>();
     }
 
-    void IndoorAtlasOnOrientationChanged(Quaternion orientation) {
-        m_camera.transform.rotation = orientation;
+    void OnEnable() {
+        m_session = GetComponentInParent<IndoorAtlasSession>();
+        if (m_session) m_session.orientationDataChanged += OnOrientationChanged;
+        m_count = 0;
+        m_newest = -1;
+        Application.onBeforeRender += OnBeforeRender;
+    }
+
+    void OnDisable() {
+        Application.onBeforeRender -= OnBeforeRender;
+        if (m_session) m_session.orientationDataChanged -= OnOrientationChanged;
+        m_session = null;
+    }
+
+    void OnOrientationChanged(in OrientationData orientation) {
+        // Out of order samples would only make the interpolation go backwards
+        if (m_count > 0 && orientation.timestamp <= m_timestamps[m_newest]) return;
+        double arrival = NowMilliseconds();
+        double delta = arrival - orientation.timestamp;
+        if (m_count == 0 || delta < m_clockOffset) m_clockOffset = delta;
+        else m_clockOffset += (delta - m_clockOffset) * OffsetDrift;
+
+        if (m_count > 0) {
+            float interval = orientation.timestamp - m_timestamps[m_newest];
+            // the gap after the samples stopped says nothing about their rate
+            if (m_count == 1) m_interval = interval;
+            else if (interval <= StaleIntervals * m_interval) m_interval = Mathf.Lerp(m_interval, interval, LatencySmoothing);
+        }
+        m_newest = (m_newest + 1) % Capacity;
+        m_rotations[m_newest] = new Quaternion((float)orientation.x, (float)orientation.y, (float)orientation.z, (float)orientation.w);
+        m_timestamps[m_newest] = orientation.timestamp;
+        m_lastArrival = arrival;
+        m_count = Math.Min(m_count + 1, Capacity);
+        float delay = (float)((delta - m_clockOffset) / 1000.0);
+        latency = (m_count == 1 ? delay : Mathf.Lerp(latency, delay, LatencySmoothing));
+    }
+
+    // Returns the i:th newest sample, 0 being the newest
+    int Sample(int i) {
+        return (m_newest - i + Capacity) % Capacity;
+    }
+
+    // time is in the clock of the sample timestamps, now is local
+    Quaternion Evaluate(double now, double time) {
+        int newer = Sample(0);
+        if (m_count == 1) return m_rotations[newer];
+        // Find the samples around time, or the two newest ones to extrapolate from
+        int older = Sample(1);
+        if (time < m_timestamps[newer]) {
+            for (int i = 1; i < m_count; ++i) {
+                older = Sample(i);
+                if (m_timestamps[older] <= time) break;
+                newer = older;
+            }
+            if (time <= m_timestamps[older]) return m_rotations[older];
+        } else {
+            // Without newer samples the device is most likely still and filtered out, not turning on
+            if (now - m_lastArrival > StaleIntervals * m_interval) return m_rotations[newer];
+            time = Math.Min(time, m_timestamps[newer] + Mathf.Min(latency, m_maxExtrapolation) * 1000.0);
+        }
+        double t = (time - m_timestamps[older]) / (m_timestamps[newer] - m_timestamps[older]);
+        return Quaternion.SlerpUnclamped(m_rotations[older], m_rotations[newer], (float)t);
+    }
+
+    void OnBeforeRender() {
+        if (m_count == 0) return;
+        double now = NowMilliseconds();
+        Quaternion q = Evaluate(now, now - m_clockOffset - m_interpolationDelay * 1000.0);
+        OrientationData data = new OrientationData { x = q.x, y = q.y, z = q.z, w = q.w };
+        m_camera.transform.rotation = data.ToUnity();
     }
 }
 
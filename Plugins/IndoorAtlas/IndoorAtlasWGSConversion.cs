@@ -1,8 +1,107 @@
 using System.Collections;
 using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using Unity.Collections;
 using UnityEngine;
 
 namespace IndoorAtlas {
+/// <summary>
+/// Blittable linear approximation of WGS84 around an origin, the math behind <c>WGSConversion</c>.
+/// It has no managed references, so it can be copied into jobs and Burst compiled code to convert
+/// coordinates there. All computation is in double precision.
+/// </summary>
+[StructLayout(LayoutKind.Sequential)]
+public struct WGSLinearization {
+    /// <summary>
+    /// Latitude and longitude of the origin in degrees.
+    /// </summary>
+    public double latitude, longitude;
+    /// <summary>
+    /// Meters per degree of longitude and latitude at the origin.
+    /// </summary>
+    public double metersPerDegreeEast, metersPerDegreeNorth;
+
+    /// <summary>
+    /// Computes the linearization at (latitude, longitude).
+    /// </summary>
+    /// <param name="latitude">The latitude of origin in degrees</param>
+    /// <param name="longitude">The longitude of origin in degrees</param>
+    public static WGSLinearization At(double latitude, double longitude) {
+        const double a = 6378137.0;            // Earth's semimajor axis in meters in WGS84
+        const double f = 1.0 / 298.257223563;  // Earth's flattening in WGS84
+        const double b = a * (1.0 - f);
+        const double a2 = a * a;
+        const double b2 = b * b;
+        double sinlat = System.Math.Sin(System.Math.PI / 180.0 * latitude);
+        double coslat = System.Math.Cos(System.Math.PI / 180.0 * latitude);
+        double tmp = System.Math.Sqrt(a2 * coslat * coslat + b2 * sinlat * sinlat);
+        return new WGSLinearization {
+            latitude = latitude,
+            longitude = longitude,
+            metersPerDegreeEast = (System.Math.PI / 180.0) * (a2 / tmp) * coslat,
+            metersPerDegreeNorth = (System.Math.PI / 180.0) * (a2 * b2 / (tmp * tmp * tmp)),
+        };
+    }
+
+    /// <summary>
+    /// Converts (latitude, longitude) to (east, north) meters from the origin.
+    /// </summary>
+    public void ToEN(double lat, double lon, out double east, out double north) {
+        east = metersPerDegreeEast * (lon - longitude);
+        north = metersPerDegreeNorth * (lat - latitude);
+    }
+
+    /// <summary>
+    /// Converts (east, north) meters from the origin to (latitude, longitude).
+    /// </summary>
+    public void ToWGS(double east, double north, out double lat, out double lon) {
+        lat = latitude + north / metersPerDegreeNorth;
+        lon = longitude + east / metersPerDegreeEast;
+    }
+
+    /// <summary>
+    /// Converts count points starting at index start of the arrays to (east, north) meters from the origin.
+    /// </summary>
+    public static void ToEN(WGSLinearization l, double[] latitudes, double[] longitudes, double[] easts, double[] norths, int start, int count) {
+        for (int i = start, end = start + count; i < end; ++i) {
+            easts[i] = l.metersPerDegreeEast * (longitudes[i] - l.longitude);
+            norths[i] = l.metersPerDegreeNorth * (latitudes[i] - l.latitude);
+        }
+    }
+
+    /// <summary>
+    /// Converts count points starting at index start of the arrays from (east, north) meters to (latitude, longitude).
+    /// </summary>
+    public static void ToWGS(WGSLinearization l, double[] easts, double[] norths, double[] latitudes, double[] longitudes, int start, int count) {
+        for (int i = start, end = start + count; i < end; ++i) {
+            latitudes[i] = l.latitude + norths[i] / l.metersPerDegreeNorth;
+            longitudes[i] = l.longitude + easts[i] / l.metersPerDegreeEast;
+        }
+    }
+
+    /// <summary>
+    /// Converts all points of the arrays to (east, north) meters from the origin. The arrays must be of the same
+    /// length. Static and free of managed references, so it can be called from jobs and Burst compiled code.
+    /// </summary>
+    public static void ToEN(WGSLinearization l, NativeArray<double> latitudes, NativeArray<double> longitudes, NativeArray<double> easts, NativeArray<double> norths) {
+        for (int i = 0; i < easts.Length; ++i) {
+            easts[i] = l.metersPerDegreeEast * (longitudes[i] - l.longitude);
+            norths[i] = l.metersPerDegreeNorth * (latitudes[i] - l.latitude);
+        }
+    }
+
+    /// <summary>
+    /// Converts all points of the arrays from (east, north) meters to (latitude, longitude). The arrays must be of
+    /// the same length. Static and free of managed references, so it can be called from jobs and Burst compiled code.
+    /// </summary>
+    public static void ToWGS(WGSLinearization l, NativeArray<double> easts, NativeArray<double> norths, NativeArray<double> latitudes, NativeArray<double> longitudes) {
+        for (int i = 0; i < easts.Length; ++i) {
+            latitudes[i] = l.latitude + norths[i] / l.metersPerDegreeNorth;
+            longitudes[i] = l.longitude + easts[i] / l.metersPerDegreeEast;
+        }
+    }
+}
+
 /// <summary>
 /// A utility class which converts IndoorAtlas SDK's location coordinates to metric
 /// (east, north) coordinates. This is achieved with a linear approximation around
@@ -10,34 +109,63 @@ namespace IndoorAtlas {
 /// in the 3D world whose (latitude, longitude) and (x, y, z) relation can be
 /// determined accurately.
 /// The origin has to be updated if the movement is "great" with respect to Earth's
-/// curvature (e.g. moving to another side of the world in a simulated environment).
+/// curvature (e.g. moving to another side of the world in a simulated environment),
+/// either with <c>SetOrigin</c> or automatically by setting <c>recenterDistance</c> and
+/// reporting the user's location with <c>Track</c>.
 /// </summary>
 public class WGSConversion {
-    private double lat0;
-    private double lon0;
-    private double deltaX;
-    private double deltaY;
+    private WGSLinearization linearization;
     private bool hasLinearizationPoint = false;
 
+    /// <summary>
+    /// Distance in meters from the origin beyond which <c>Track</c> moves the origin to the tracked location,
+    /// 0 (the default) never moves it.
+    /// </summary>
+    public double recenterDistance { get; set; }
+
+    /// <summary>
+    /// Invoked after the origin changes, metric coordinates converted before that must be converted again.
+    /// </summary>
+    public event System.Action originChanged;
+
+    /// <summary>
+    /// The linearization around the current origin, to be passed to jobs.
+    /// </summary>
+    public WGSLinearization origin {
+        get { return linearization; }
+    }
+
     /// <summary>
     /// Sets the origin in metric coordinates to (latitude, longitude) location.
     /// </summary>
     /// <param name="latitude">The latitude of origin in degrees</param>
     /// <param name="longitude">The longitude of origin in degrees</param>
     public void SetOrigin(double latitude, double longitude) {
-        lat0 = latitude;
-        lon0 = longitude;
-        const double a = 6378137.0;            // Earth's semimajor axis in meters in WGS84
-        const double f = 1.0 / 298.257223563;  // Earth's flattening in WGS84
-        const double b = a * (1.0 - f);
-        const double a2 = a * a;
-        const double b2 = b * b;
-        double sinlat = System.Math.Sin(System.Math.PI / 180.0 * latitude);
-        double coslat = System.Math.Cos(System.Math.PI / 180.0 * latitude);
-        double tmp = System.Math.Sqrt(a2 * coslat * coslat + b2 * sinlat * sinlat);
-        deltaX = (System.Math.PI / 180.0) * (a2 / tmp) * coslat;
-        deltaY = (System.Math.PI / 180.0) * (a2 * b2 / (tmp * tmp * tmp));
+        linearization = WGSLinearization.At(latitude, longitude);
         hasLinearizationPoint = true;
+        if (originChanged != null) originChanged();
+    }
+
+    /// <summary>
+    /// Reports the user's location. Sets the origin there if there is none yet, or if the location is
+    /// farther than <c>recenterDistance</c> from the origin.
+    /// </summary>
+    /// <param name="latitude">Latitude in degrees</param>
+    /// <param name="longitude">Longitude in degrees</param>
+    /// <returns>True if the origin was moved.</returns>
+    public bool Track(double latitude, double longitude) {
+        if (hasLinearizationPoint) {
+            if (recenterDistance <= 0) return false;
+            double east, north;
+            linearization.ToEN(latitude, longitude, out east, out north);
+            if (east * east + north * north <= recenterDistance * recenterDistance) return false;
+        }
+        SetOrigin(latitude, longitude);
+        return true;
+    }
+
+    void CheckOrigin() {
+        if (!hasLinearizationPoint) throw new System.InvalidOperationException("Origin hasn't been set before the conversion.");
     }
 
     /// <summary>
@@ -52,8 +180,69 @@ public class WGSConversion {
     /// Thrown if setOrigin hasn't been called before this function call.
     /// </exception>
     public Vector2 WGStoEN(double latitude, double longitude) {
-        if (!hasLinearizationPoint) throw new System.InvalidOperationException("Origin hasn't been set before the conversion.");
-        return new Vector2((float)(deltaX * (longitude - lon0)), (float)(deltaY * (latitude - lat0)));
+        CheckOrigin();
+        double east, north;
+        linearization.ToEN(latitude, longitude, out east, out north);
+        return new Vector2((float)east, (float)north);
+    }
+
+    /// <summary>
+    /// Double precision version of <c>WGStoEN</c>, for points far from the origin.
+    /// </summary>
+    /// <exception cref="System.InvalidOperationException">
+    /// Thrown if setOrigin hasn't been called before this function call.
+    /// </exception>
+    public void WGStoEN(double latitude, double longitude, out double east, out double north) {
+        CheckOrigin();
+        linearization.ToEN(latitude, longitude, out east, out north);
+    }
+
+    /// <summary>
+    /// Converts (east, north) metric coordinates with respect to the origin back to (latitude, longitude).
+    /// </summary>
+    /// <param name="en">Metric coordinates in the local (east, north) coordinate system</param>
+    /// <param name="latitude">Latitude in degrees</param>
+    /// <param name="longitude">Longitude in degrees</param>
+    /// <exception cref="System.InvalidOperationException">
+    /// Thrown if setOrigin hasn't been called before this function call.
+    /// </exception>
+    public void ENtoWGS(Vector2 en, out double latitude, out double longitude) {
+        CheckOrigin();
+        linearization.ToWGS(en.x, en.y, out latitude, out longitude);
+    }
+
+    /// <summary>
+    /// Double precision version of <c>ENtoWGS</c>.
+    /// </summary>
+    public void ENtoWGS(double east, double north, out double latitude, out double longitude) {
+        CheckOrigin();
+        linearization.ToWGS(east, north, out latitude, out longitude);
+    }
+
+    /// <summary>
+    /// Converts count points starting at index start of the arrays to metric coordinates in one pass.
+    /// </summary>
+    /// <param name="latitudes">Latitudes in degrees</param>
+    /// <param name="longitudes">Longitudes in degrees</param>
+    /// <param name="easts">Receives the east coordinates, at the same indices</param>
+    /// <param name="norths">Receives the north coordinates, at the same indices</param>
+    /// <exception cref="System.InvalidOperationException">
+    /// Thrown if setOrigin hasn't been called before this function call.
+    /// </exception>
+    public void WGStoEN(double[] latitudes, double[] longitudes, double[] easts, double[] norths, int start, int count) {
+        CheckOrigin();
+        WGSLinearization.ToEN(linearization, latitudes, longitudes, easts, norths, start, count);
+    }
+
+    /// <summary>
+    /// Converts count metric points starting at index start of the arrays back to (latitude, longitude) in one pass.
+    /// </summary>
+    /// <exception cref="System.InvalidOperationException">
+    /// Thrown if setOrigin hasn't been called before this function call.
+    /// </exception>
+    public void ENtoWGS(double[] easts, double[] norths, double[] latitudes, double[] longitudes, int start, int count) {
+        CheckOrigin();
+        WGSLinearization.ToWGS(linearization, easts, norths, latitudes, longitudes, start, count);
     }
 
     /// <summary>
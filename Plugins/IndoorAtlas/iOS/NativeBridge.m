@@ -5,12 +5,107 @@
 @property (nonatomic, strong) IALocationManager *manager;
 @property (nonatomic, copy) NSString *key, *secret;
 @property (nonatomic, copy) NSString *gameObject;
+@property (nonatomic) int eventTransport;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, NSString*> *sentVenues;
+@property (nonatomic, strong) NSMutableDictionary<NSString*, IAVenue*> *sentVenueObjects;
+@property (nonatomic, copy) NSString *traceId;
+@property (nonatomic, strong) IARegion *lastRegion; // latest entered region, serialized by indooratlas_benchmarkSerializer
+- (void)resetArAlignment;
+- (void)updateArAlignment;
 @end
 
 @interface IALocationManager ()
 - (void)setObject:(id)object forKey:(NSString*)key;
 @end
 
+enum {
+    IA_TRANSPORT_JSON = 0,
+    IA_TRANSPORT_BINARY = 1,
+};
+
+enum {
+    IA_EVENT_LOCATION = 1,
+    IA_EVENT_HEADING = 2,
+    IA_EVENT_ORIENTATION = 3,
+    IA_EVENT_STATUS = 4,
+    IA_EVENT_MAX_TYPES = 8,
+    IA_EVENT_RING_CAPACITY = 64, // must be power of two
+};
+
+// Fixed-layout event record, must be kept in sync with IndoorAtlasEventBuffer.cs
+typedef struct {
+    int32_t sequence; // odd while a latest slot is being written
+    int32_t type;
+    int64_t timestamp; // milliseconds
+    int32_t floor;
+    int32_t code;
+    double values[5];
+} ia_event;
+
+_Static_assert(sizeof(ia_event) == 64, "ia_event must be 64 bytes");
+
+// Event buffer shared with IndoorAtlasSession, which drains it every frame.
+// Single producer (delegate callbacks), single consumer (Unity main thread).
+typedef struct {
+    struct {
+        int32_t head; // written by producer
+        int32_t tail; // written by consumer
+        int32_t capacity;
+        int32_t keep_latest; // bit (1 << type) set if only latest event of type is kept, written by consumer
+        int32_t dropped[IA_EVENT_MAX_TYPES];
+        int32_t ar_alignment; // incremented when the geo to AR alignment changes, written by producer
+        int32_t reserved[3];
+    } header;
+    ia_event latest[IA_EVENT_MAX_TYPES];
+    ia_event ring[IA_EVENT_RING_CAPACITY];
+} ia_event_buffer;
+
+_Static_assert(sizeof(((ia_event_buffer*)0)->header) == 64, "ia_event_buffer header must be 64 bytes");
+
+static ia_event_buffer _events = { .header = { .capacity = IA_EVENT_RING_CAPACITY } };
+
+static void
+event_fill(ia_event *e, int32_t type, int64_t timestamp, int32_t floor, int32_t code, double v0, double v1, double v2, double v3, double v4) {
+    e->type = type;
+    e->timestamp = timestamp;
+    e->floor = floor;
+    e->code = code;
+    e->values[0] = v0;
+    e->values[1] = v1;
+    e->values[2] = v2;
+    e->values[3] = v3;
+    e->values[4] = v4;
+}
+
+static void
+event_add_dropped(int32_t type) {
+    __atomic_fetch_add(&_events.header.dropped[type], 1, __ATOMIC_RELAXED);
+}
+
+static void
+event_push(const ia_event *event) {
+    const int32_t type = event->type;
+    if (__atomic_load_n(&_events.header.keep_latest, __ATOMIC_RELAXED) & (1 << type)) {
+        ia_event *e = &_events.latest[type];
+        const int32_t sequence = __atomic_load_n(&e->sequence, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->sequence, sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        event_fill(e, type, event->timestamp, event->floor, event->code, event->values[0], event->values[1], event->values[2], event->values[3], event->values[4]);
+        __atomic_store_n(&e->sequence, sequence + 2, __ATOMIC_RELEASE);
+        return;
+    }
+
+    const int32_t head = __atomic_load_n(&_events.header.head, __ATOMIC_RELAXED);
+    const int32_t tail = __atomic_load_n(&_events.header.tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= IA_EVENT_RING_CAPACITY) {
+        event_add_dropped(type);
+        return;
+    }
+    ia_event *e = &_events.ring[(uint32_t)head % IA_EVENT_RING_CAPACITY];
+    event_fill(e, type, event->timestamp, event->floor, event->code, event->values[0], event->values[1], event->values[2], event->values[3], event->values[4]);
+    __atomic_store_n(&_events.header.head, head + 1, __ATOMIC_RELEASE);
+}
+
 static NSString*
 dict_to_json(NSDictionary *dictionary) {
     NSError *error;
@@ -106,17 +201,46 @@ venue_to_dict(IAVenue *venue) {
     };
 }
 
+// 64-bit FNV-1a of the venue serialized with sorted keys, changes whenever any of its content does
 static NSString*
-region_to_json(IARegion *region) {
-    return dict_to_json(@{
+venue_hash(NSDictionary *venue) {
+    NSData *data = [NSJSONSerialization dataWithJSONObject:venue options:NSJSONWritingSortedKeys error:nil];
+    const uint8_t *bytes = data.bytes;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (NSUInteger i = 0; i < data.length; ++i) hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return [NSString stringWithFormat:@"%016llx", hash];
+}
+
+// The venue is only included the first time it (or a changed version of it) is sent,
+// afterwards the region refers to it by venueId and venueHash and Unity uses its cached copy.
+// The SDK hands over the same venue object until the venue changes, so it is only serialized and
+// hashed again for a different object. sentVenueObjects keeps the objects alive, so their addresses
+// can't be reused by other venues.
+static NSString*
+region_to_json(IARegion *region, NSMutableDictionary<NSString*, NSString*> *sentVenues,
+               NSMutableDictionary<NSString*, IAVenue*> *sentVenueObjects) {
+    NSMutableDictionary *dict = [@{
                 @"id": region.identifier,
                 @"name": region.name,
                 @"type": @(region.type),
                 @"timestamp": region.timestamp ? @(region.timestamp.timeIntervalSince1970) : @(-1),
-                @"venue": venue_to_dict(region.venue),
                 @"floorplan": floorplan_to_dict(region.floorplan),
                 @"geofence": geofence_to_dict((IAGeofence*)region)
-            });
+            } mutableCopy];
+    if (region.venue.id) {
+        dict[@"venueId"] = region.venue.id;
+        if (sentVenueObjects[region.venue.id] != region.venue) {
+            NSDictionary *venue = venue_to_dict(region.venue);
+            NSString *hash = venue_hash(venue);
+            if (![sentVenues[region.venue.id] isEqualToString:hash]) {
+                dict[@"venue"] = venue;
+                sentVenues[region.venue.id] = hash;
+            }
+            sentVenueObjects[region.venue.id] = region.venue;
+        }
+        dict[@"venueHash"] = sentVenues[region.venue.id];
+    }
+    return dict_to_json(dict);
 }
 
 static NSDictionary*
@@ -162,29 +286,69 @@ route_to_json(IARoute *route) {
            });
 }
 
+// Callback of IndoorAtlasSession for each event type
+static const char *event_callbacks[IA_EVENT_MAX_TYPES] = {
+    [IA_EVENT_LOCATION] = "NativeIndoorAtlasOnLocationChanged",
+    [IA_EVENT_HEADING] = "NativeIndoorAtlasOnHeadingChanged",
+    [IA_EVENT_ORIENTATION] = "NativeIndoorAtlasOnOrientationChanged",
+    [IA_EVENT_STATUS] = "NativeIndoorAtlasOnStatusChanged",
+};
+
 static NSString*
-location_to_json(IALocation *location) {
-    if (!location) return @"";
-    CLLocation *l = location.location;
-    return dict_to_json(@{
-          @"accuracy": @(l.horizontalAccuracy),
-          @"altitude": @(l.altitude),
-          @"bearing": @(l.course),
-          @"position": @{
-              @"coordinate": @{
-                  @"latitude": @(l.coordinate.latitude),
-                  @"longitude": @(l.coordinate.longitude)
-              },
-              @"floor": @(l.floor.level),
-          },
-          @"timestamp": @([l.timestamp timeIntervalSince1970])
-      });
-}
-
-@implementation IAUnityPlugin
+event_to_json(const ia_event *e) {
+    switch (e->type) {
+        case IA_EVENT_LOCATION:
+            return dict_to_json(@{
+                  @"accuracy": @(e->values[2]),
+                  @"altitude": @(e->values[3]),
+                  @"bearing": @(e->values[4]),
+                  @"position": @{
+                      @"coordinate": @{
+                          @"latitude": @(e->values[0]),
+                          @"longitude": @(e->values[1])
+                      },
+                      @"floor": @(e->floor),
+                  },
+                  @"timestamp": @(e->timestamp)
+              });
+        case IA_EVENT_HEADING:
+            return dict_to_json(@{
+                  @"heading": @(e->values[0]),
+                  @"timestamp": @(e->timestamp)
+              });
+        case IA_EVENT_ORIENTATION:
+            return dict_to_json(@{
+                  @"x": @(e->values[0]),
+                  @"y": @(e->values[1]),
+                  @"z": @(e->values[2]),
+                  @"w": @(e->values[3]),
+                  @"timestamp": @(e->timestamp)
+              });
+        case IA_EVENT_STATUS:
+            return dict_to_json(@{@"status": @(e->code)});
+    }
+    return @"";
+}
+
+@implementation IAUnityPlugin {
+    // Per event type rate limit, samples arriving faster are coalesced so that only the latest one is delivered
+    NSTimeInterval _rateInterval[IA_EVENT_MAX_TYPES]; // seconds, 0 delivers every event
+    NSTimeInterval _rateLast[IA_EVENT_MAX_TYPES];
+    ia_event _ratePending[IA_EVENT_MAX_TYPES];
+    bool _rateScheduled[IA_EVENT_MAX_TYPES];
+    // Geo to AR alignment tracking, a fixed reference point is converted whenever the AR pose is set
+    // and the alignment version in the event buffer header is bumped when its matrix changes
+    CLLocationCoordinate2D _arProbe;
+    int _arProbeFloor;
+    bool _arHasProbe, _arAligned;
+    simd_float4x4 _arAlignment;
+}
+
 - (id)initWithObject:(NSString *)gameObjectName apiKey:(NSString *)apiKey apiSecret:(NSString *)apiSecret apiEndpoint:(NSString*)apiEndpoint {
     self = [super init];
     self.gameObject = gameObjectName;
+    self.sentVenues = [NSMutableDictionary dictionary];
+    self.sentVenueObjects = [NSMutableDictionary dictionary];
     self.manager = [IALocationManager sharedInstance];
     self.manager.delegate = self;
     // TODO: get version from saner place
@@ -198,51 +362,138 @@ location_to_json(IALocation *location) {
     [self.manager stopUpdatingLocation];
 }
 
+- (void)resetArAlignment {
+    _arHasProbe = false;
+    if (_arAligned) __atomic_fetch_add(&_events.header.ar_alignment, 1, __ATOMIC_RELEASE);
+    _arAligned = false;
+}
+
+// Called after every AR pose update, the probe is the first location received and never moves,
+// so any change of its AR matrix is a change of the alignment
+- (void)updateArAlignment {
+    IAARSession *session = self.manager.arSession;
+    const bool aligned = _arHasProbe && session.converged;
+    simd_float4x4 matrix = matrix_identity_float4x4;
+    if (aligned) matrix = [session geoToAr:_arProbe floorNumber:_arProbeFloor heading:0 zOffset:0];
+    if (aligned == _arAligned && (!aligned || memcmp(&matrix, &_arAlignment, sizeof(matrix)) == 0)) return;
+    _arAligned = aligned;
+    _arAlignment = matrix;
+    __atomic_fetch_add(&_events.header.ar_alignment, 1, __ATOMIC_RELEASE);
+}
+
+- (void)setRateInterval:(NSTimeInterval)interval forType:(int32_t)type {
+    if (type <= 0 || type >= IA_EVENT_MAX_TYPES) return;
+    _rateInterval[type] = MAX(interval, 0);
+}
+
+- (void)sendEvent:(const ia_event*)e {
+    if (self.eventTransport == IA_TRANSPORT_BINARY) {
+        event_push(e);
+        return;
+    }
+    NSString *json = event_to_json(e);
+    UnitySendMessage(self.gameObject.UTF8String, event_callbacks[e->type], json.UTF8String);
+}
+
+- (void)flushEvent:(int32_t)type {
+    if (!_rateScheduled[type]) return;
+    _rateScheduled[type] = false;
+    _rateLast[type] = [NSProcessInfo processInfo].systemUptime;
+    [self sendEvent:&_ratePending[type]];
+}
+
+// Delegate callbacks and the flush below all run on the main queue, so the rate limit state needs no locking
+- (void)deliverEvent:(const ia_event*)e {
+    const int32_t type = e->type;
+    const NSTimeInterval interval = _rateInterval[type];
+    if (interval > 0) {
+        const NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+        const NSTimeInterval elapsed = now - _rateLast[type];
+        if (elapsed < interval) {
+            // Replacing a sample that was never delivered counts as a drop, same as a full ring
+            if (_rateScheduled[type]) event_add_dropped(type);
+            _ratePending[type] = *e;
+            if (!_rateScheduled[type]) {
+                _rateScheduled[type] = true;
+                __weak IAUnityPlugin *weakSelf = self;
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)((interval - elapsed) * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+                    [weakSelf flushEvent:type];
+                });
+            }
+            return;
+        }
+        _rateLast[type] = now;
+    }
+    if (_rateScheduled[type]) {
+        // The flush is due but has not run yet, this newer sample replaces the pending one
+        // instead of being delivered before it. The dispatched flush finds nothing scheduled.
+        _rateScheduled[type] = false;
+        event_add_dropped(type);
+    }
+    [self sendEvent:e];
+}
+
 - (void)indoorLocationManager:(IALocationManager*)manager didUpdateLocations:(NSArray*)locations {
     (void)manager;
-    NSString *json = location_to_json(locations.lastObject);
-    UnitySendMessage(self.gameObject.UTF8String, "NativeIndoorAtlasOnLocationChanged", json.UTF8String);
+    CLLocation *l = ((IALocation*)locations.lastObject).location;
+    if (!l) return;
+    if (!_arHasProbe) {
+        _arProbe = l.coordinate;
+        _arProbeFloor = (int)l.floor.level;
+        _arHasProbe = true;
+    }
+    ia_event e;
+    event_fill(&e, IA_EVENT_LOCATION, (int64_t)([l.timestamp timeIntervalSince1970] * 1000.0), (int32_t)l.floor.level, 0,
+                l.coordinate.latitude, l.coordinate.longitude, l.horizontalAccuracy, l.altitude, l.course);
+    [self deliverEvent:&e];
 }
 
 - (void)indoorLocationManager:(IALocationManager *)manager didUpdateAttitude:(nonnull IAAttitude *)newAttitude {
     (void)manager;
-    NSString *json = dict_to_json(@{
-                @"x": @(newAttitude.quaternion.x),
-                @"y": @(newAttitude.quaternion.y),
-                @"z": @(newAttitude.quaternion.z),
-                @"w": @(newAttitude.quaternion.w),
-                @"timestamp": @((long)([newAttitude.timestamp timeIntervalSince1970] * 1000.0))
-            });
-    UnitySendMessage(self.gameObject.UTF8String, "NativeIndoorAtlasOnOrientationChanged", json.UTF8String);
+    ia_event e;
+    event_fill(&e, IA_EVENT_ORIENTATION, (int64_t)([newAttitude.timestamp timeIntervalSince1970] * 1000.0), 0, 0,
+                newAttitude.quaternion.x, newAttitude.quaternion.y, newAttitude.quaternion.z, newAttitude.quaternion.w, 0);
+    [self deliverEvent:&e];
 }
 
 - (void)indoorLocationManager:(nonnull IALocationManager *)manager didUpdateHeading:(nonnull IAHeading *)newHeading {
     (void)manager;
-    NSString *json = dict_to_json(@{
-                @"heading": @(newHeading.trueHeading),
-                @"timestamp": @((long)(newHeading.timestamp.timeIntervalSince1970 * 1000.0))
-            });
-    UnitySendMessage(self.gameObject.UTF8String, "NativeIndoorAtlasOnHeadingChanged", json.UTF8String);
+    ia_event e;
+    event_fill(&e, IA_EVENT_HEADING, (int64_t)(newHeading.timestamp.timeIntervalSince1970 * 1000.0), 0, 0,
+                newHeading.trueHeading, 0, 0, 0, 0);
+    [self deliverEvent:&e];
 }
 
 - (void)indoorLocationManager:(nonnull IALocationManager *)manager statusChanged:(nonnull IAStatus *)status {
     (void)manager;
-    NSString *json = dict_to_json(@{@"status": @(status.type)});
-    UnitySendMessage(self.gameObject.UTF8String, "NativeIndoorAtlasOnStatusChanged", json.UTF8String);
+    ia_event e;
+    event_fill(&e, IA_EVENT_STATUS, (int64_t)([[NSDate date] timeIntervalSince1970] * 1000.0), 0, (int32_t)status.type, 0, 0, 0, 0, 0);
+    [self deliverEvent:&e];
 }
 
 - (void)indoorLocationManager:(IALocationManager *)manager didEnterRegion:(IARegion *)region {
     (void)manager;
-    NSString *json = region_to_json(region);
+    self.lastRegion = region;
+    NSString *json = region_to_json(region, self.sentVenues, self.sentVenueObjects);
     UnitySendMessage(self.gameObject.UTF8String, "NativeIndoorAtlasOnEnterRegion", json.UTF8String);
 }
 
 - (void)indoorLocationManager:(IALocationManager *)manager didExitRegion:(IARegion *)region {
     (void)manager;
-    NSString *json = region_to_json(region);
+    NSString *json = region_to_json(region, self.sentVenues, self.sentVenueObjects);
     UnitySendMessage(self.gameObject.UTF8String, "NativeIndoorAtlasOnExitRegion", json.UTF8String);
 }
 
+- (void)indoorLocationManager:(IALocationManager *)manager didReceiveExtraInfo:(NSDictionary *)extraInfo {
+    (void)manager;
+    // Unity keeps the latest extra info cached, so it is only sent when it changes
+    NSString *traceId = extraInfo[kIATraceId] ?: @"";
+    if ([traceId isEqualToString:self.traceId]) return;
+    self.traceId = traceId;
+    NSString *json = dict_to_json(@{@"traceId": traceId});
+    UnitySendMessage(self.gameObject.UTF8String, "NativeIndoorAtlasOnExtraInfo", json.UTF8String);
+}
+
 - (void)indoorLocationManager:(IALocationManager *)manager didUpdateRoute:(IARoute *)route {
     (void)manager;
     NSString *json = route_to_json(route);
@@ -287,24 +538,18 @@ nsstring_to_unity_string(NSString *str) {
     return cpy;
 }
 
+// Unity's Matrix4x4 and simd_float4x4 are both 16 column-major floats without padding,
+// the copy is only needed because Unity's matrices are not 16-byte aligned
+_Static_assert(sizeof(simd_float4x4) == 16 * sizeof(float), "simd_float4x4 must be 16 packed floats");
+
 static void
 simd_float4x4_to_unity_matrix(const simd_float4x4 *in, float out[16]) {
-    for (int i = 0; i < 4; ++i) {
-        out[i * 4 + 0] = in->columns[i].x;
-        out[i * 4 + 1] = in->columns[i].y;
-        out[i * 4 + 2] = in->columns[i].z;
-        out[i * 4 + 3] = in->columns[i].w;
-    }
+    memcpy(out, in, sizeof(*in));
 }
 
 static void
 unity_matrix_to_simd_float4x4(const float in[16], simd_float4x4 *out) {
-    for (int i = 0; i < 4; ++i) {
-        out->columns[i].x = in[i * 4 + 0];
-        out->columns[i].y = in[i * 4 + 1];
-        out->columns[i].z = in[i * 4 + 2];
-        out->columns[i].w = in[i * 4 + 3];
-    }
+    memcpy(out, in, sizeof(*out));
 }
 
 bool
@@ -326,6 +571,55 @@ indooratlas_init(const char *apiKey, const char *apiSecret, const char *apiEndpo
     return !!_plugin;
 }
 
+void
+indooratlas_setEventTransport(int transport) {
+    _plugin.eventTransport = transport;
+}
+
+void
+indooratlas_setEventRateLimit(int type, double interval) {
+    [_plugin setRateInterval:interval forType:type];
+}
+
+void*
+indooratlas_eventBuffer(void) {
+    return &_events;
+}
+
+// Serializers measured by indooratlas_benchmarkSerializer, same values as LocationManager.Serializer
+enum {
+    IA_SERIALIZER_LOCATION = 0,       // location event for the JSON transport
+    IA_SERIALIZER_REGION_VENUE = 1,   // latest entered region including its venue
+    IA_SERIALIZER_REGION = 2,         // latest entered region referring to its already sent venue
+};
+
+// Runs the serializer iterations times and stores the duration of each run in microseconds,
+// returns the number of runs, 0 if there is nothing to serialize (no region entered yet)
+int
+indooratlas_benchmarkSerializer(int serializer, int iterations, double *microseconds) {
+    IARegion *region = _plugin.lastRegion;
+    if (serializer != IA_SERIALIZER_LOCATION && !region) return 0;
+    ia_event e;
+    event_fill(&e, IA_EVENT_LOCATION, 1700000000000, 2, 0, 60.1699, 24.9384, 3.5, 12.0, 90.0);
+    NSMutableDictionary<NSString*, NSString*> *sentVenues = [NSMutableDictionary dictionary];
+    NSMutableDictionary<NSString*, IAVenue*> *sentVenueObjects = [NSMutableDictionary dictionary];
+    if (region) region_to_json(region, sentVenues, sentVenueObjects); // the venue is sent by the first call only
+    NSProcessInfo *info = [NSProcessInfo processInfo];
+    for (int i = 0; i < iterations; ++i) {
+        @autoreleasepool {
+            if (serializer == IA_SERIALIZER_REGION_VENUE) {
+                [sentVenues removeAllObjects];
+                [sentVenueObjects removeAllObjects];
+            }
+            const NSTimeInterval start = info.systemUptime;
+            if (serializer == IA_SERIALIZER_LOCATION) event_to_json(&e);
+            else region_to_json(region, sentVenues, sentVenueObjects);
+            microseconds[i] = (info.systemUptime - start) * 1e6;
+        }
+    }
+    return iterations;
+}
+
 const char*
 indooratlas_versionString(void) {
     return nsstring_to_unity_string([IALocationManager versionString]);
@@ -406,14 +700,10 @@ indooratlas_stopMonitoringForWayfinding(void) {
     [_plugin.manager stopMonitoringForWayfinding];
 }
 
-const char*
-indooratlas_traceID(void) {
-    return nsstring_to_unity_string(_plugin.manager.extraInfo[kIATraceId]);
-}
-
 void
 indooratlas_releaseArSession(void) {
     [_plugin.manager releaseArSession];
+    [_plugin resetArAlignment];
 }
 
 void
@@ -421,6 +711,7 @@ indooratlas_setArPoseMatrix(const float matrix[16]) {
     simd_float4x4 simd;
     unity_matrix_to_simd_float4x4(matrix, &simd);
     [_plugin.manager.arSession setPoseMatrix:simd];
+    [_plugin updateArAlignment];
 }
 
 void
@@ -464,11 +755,60 @@ indooratlas_getArTurnMatrix(int index, float matrix[16]) {
     return ret;
 }
 
+// Frame layout, must be kept in sync with ArFrame in IndoorAtlasApi.cs:
+// [converged, valid flags, turn count, valid turn count, compass[16], goal[16], valid turns[16 * n]]
+enum {
+    IA_AR_FRAME_HEADER = 4,
+    IA_AR_FRAME_MATRIX = 16,
+    IA_AR_FRAME_VALID_COMPASS = 1 << 0,
+    IA_AR_FRAME_VALID_GOAL = 1 << 1,
+};
+
+int
+indooratlas_getArFrame(float *frame, int capacity) {
+    if (capacity < IA_AR_FRAME_HEADER + 2 * IA_AR_FRAME_MATRIX) return 0;
+    IAARSession *session = _plugin.manager.arSession;
+    memset(frame, 0, IA_AR_FRAME_HEADER * sizeof(float));
+    if (!session.converged) return IA_AR_FRAME_HEADER;
+
+    int flags = 0, valid = 0;
+    simd_float4x4 simd = matrix_identity_float4x4;
+    if ([session.wayfindingCompassArrow updateModelMatrix:&simd]) flags |= IA_AR_FRAME_VALID_COMPASS;
+    simd_float4x4_to_unity_matrix(&simd, frame + IA_AR_FRAME_HEADER);
+    simd = matrix_identity_float4x4;
+    if ([session.wayfindingTarget updateModelMatrix:&simd]) flags |= IA_AR_FRAME_VALID_GOAL;
+    simd_float4x4_to_unity_matrix(&simd, frame + IA_AR_FRAME_HEADER + IA_AR_FRAME_MATRIX);
+
+    NSArray *turns = session.wayfindingTurnArrows;
+    const int max_turns = (capacity - IA_AR_FRAME_HEADER) / IA_AR_FRAME_MATRIX - 2;
+    for (IAARObject *turn in turns) {
+        if (valid >= max_turns) break;
+        simd = matrix_identity_float4x4;
+        if (![turn updateModelMatrix:&simd]) continue;
+        simd_float4x4_to_unity_matrix(&simd, frame + IA_AR_FRAME_HEADER + (2 + valid) * IA_AR_FRAME_MATRIX);
+        ++valid;
+    }
+
+    frame[0] = 1;
+    frame[1] = flags;
+    frame[2] = turns.count;
+    frame[3] = valid;
+    return IA_AR_FRAME_HEADER + (2 + valid) * IA_AR_FRAME_MATRIX;
+}
+
 void
 indooratlas_addArPlane(float cx, float cy, float cz, float ex, float ez) {
     [_plugin.manager.arSession addPlaneWithCenterX:cx withCenterY:cy withCenterZ:cz withExtentX:ex withExtentZ:ez];
 }
 
+void
+indooratlas_addArPlanes(const float *data, int count) {
+    IAARSession *session = _plugin.manager.arSession;
+    for (int i = 0; i < count; ++i, data += 5) {
+        [session addPlaneWithCenterX:data[0] withCenterY:data[1] withCenterZ:data[2] withExtentX:data[3] withExtentZ:data[4]];
+    }
+}
+
 void
 indooratlas_geoToAr(double lat, double lon, int floor, float heading, float zOffset, float matrix[16]) {
    CLLocationCoordinate2D coord = { lat, lon };
@@ -476,10 +816,49 @@ indooratlas_geoToAr(double lat, double lon, int floor, float heading, float zOff
    simd_float4x4_to_unity_matrix(&simd, matrix);
 }
 
-const char*
-indooratlas_arToGeo(double x, double y, double z) {
-   IALocation *l = [_plugin.manager.arSession arToGeo:x Y:y Z:z];
-   return nsstring_to_unity_string(location_to_json(l));
+void
+indooratlas_geoToArMany(const double *lat, const double *lon, const int *floor, int count, float heading, float zOffset, float *matrices) {
+   IAARSession *session = _plugin.manager.arSession;
+   for (int i = 0; i < count; ++i) {
+      CLLocationCoordinate2D coord = { lat[i], lon[i] };
+      simd_float4x4 simd = [session geoToAr:coord floorNumber:floor[i] heading:heading zOffset:zOffset];
+      simd_float4x4_to_unity_matrix(&simd, matrices + i * 16);
+   }
+}
+
+// Same layout as LocationData in IndoorAtlasApi.cs
+typedef struct {
+    double latitude, longitude, altitude;
+    int64_t timestamp; // milliseconds
+    float accuracy, bearing;
+    int32_t floor;
+} ia_location_data;
+_Static_assert(sizeof(ia_location_data) == 48, "ia_location_data must be 48 bytes");
+
+int
+indooratlas_arToGeoMany(const float *points, int count, ia_location_data *locations) {
+   IAARSession *session = _plugin.manager.arSession;
+   int converted = 0;
+   for (int i = 0; i < count; ++i) {
+      const float *p = points + i * 3;
+      IALocation *location = [session arToGeo:p[0] Y:p[1] Z:p[2]];
+      if (!location) {
+         locations[i] = (ia_location_data){0};
+         continue;
+      }
+      CLLocation *l = location.location;
+      locations[i] = (ia_location_data){
+         .latitude = l.coordinate.latitude,
+         .longitude = l.coordinate.longitude,
+         .altitude = l.altitude,
+         .timestamp = (int64_t)([l.timestamp timeIntervalSince1970] * 1000.0),
+         .accuracy = l.horizontalAccuracy,
+         .bearing = l.course,
+         .floor = (int32_t)l.floor.level,
+      };
+      ++converted;
+   }
+   return converted;
 }
 
 void
@@ -0,0 +1,114 @@
+package com.indooratlas.android.unity;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+// Event buffer shared with the C# side through a direct ByteBuffer.
+// The layout must be kept in sync with IndoorAtlasEventBuffer.cs:
+//
+//   Header (64 bytes):
+//     0  int32 head (written by producer)
+//     4  int32 tail (written by consumer)
+//     8  int32 ring capacity in records
+//     12 int32 keep latest mask, bit (1 << type) (written by consumer)
+//     16 int32 dropped[8]
+//     48 int32 AR alignment version
+//   Latest slots (MAX_TYPES records), slot index is the event type
+//   Ring (RING_CAPACITY records)
+//
+//   Record (64 bytes):
+//     0  int32  sequence (odd while a latest slot is being written)
+//     4  int32  type
+//     8  int64  timestamp (milliseconds)
+//     16 int32  floor
+//     20 int32  code
+//     24 double values[5]
+//
+// Single producer (the main looper where SDK callbacks are delivered), single consumer (Unity main thread).
+final class EventBuffer {
+    static final int TRANSPORT_JSON = 0;
+    static final int TRANSPORT_BINARY = 1;
+
+    static final int TYPE_LOCATION = 1;
+    static final int TYPE_HEADING = 2;
+    static final int TYPE_ORIENTATION = 3;
+    static final int TYPE_STATUS = 4;
+    static final int MAX_TYPES = 8;
+
+    static final int HEADER_SIZE = 64;
+    static final int RECORD_SIZE = 64;
+    static final int RING_CAPACITY = 64; // must be power of two
+
+    private static final int HEAD_OFFSET = 0;
+    private static final int TAIL_OFFSET = 4;
+    private static final int CAPACITY_OFFSET = 8;
+    private static final int KEEP_LATEST_OFFSET = 12;
+    private static final int DROPPED_OFFSET = 16;
+    private static final int AR_ALIGNMENT_OFFSET = 48;
+    private static final int LATEST_OFFSET = HEADER_SIZE;
+    private static final int RING_OFFSET = LATEST_OFFSET + MAX_TYPES * RECORD_SIZE;
+
+    private final ByteBuffer mBuffer = ByteBuffer.allocateDirect(RING_OFFSET + RING_CAPACITY * RECORD_SIZE).order(ByteOrder.nativeOrder());
+    private volatile int mBarrier;
+
+    EventBuffer() {
+        mBuffer.putInt(CAPACITY_OFFSET, RING_CAPACITY);
+    }
+
+    // Volatile store followed by volatile load acts as a full memory barrier
+    private void fence() {
+        mBarrier = 0;
+        if (mBarrier != 0) throw new IllegalStateException();
+    }
+
+    ByteBuffer getBuffer() {
+        return mBuffer;
+    }
+
+    private void fill(int offset, int type, long timestamp, int floor, int code, double v0, double v1, double v2, double v3, double v4) {
+        mBuffer.putInt(offset + 4, type);
+        mBuffer.putLong(offset + 8, timestamp);
+        mBuffer.putInt(offset + 16, floor);
+        mBuffer.putInt(offset + 20, code);
+        mBuffer.putDouble(offset + 24, v0);
+        mBuffer.putDouble(offset + 32, v1);
+        mBuffer.putDouble(offset + 40, v2);
+        mBuffer.putDouble(offset + 48, v3);
+        mBuffer.putDouble(offset + 56, v4);
+    }
+
+    // Counts an event that was never delivered to the C# side
+    void addDropped(int type) {
+        final int dropped = DROPPED_OFFSET + type * 4;
+        mBuffer.putInt(dropped, mBuffer.getInt(dropped) + 1);
+    }
+
+    // Written by the thread setting the AR pose, the C# side only compares it with the value it saw last
+    void addArAlignment() {
+        mBuffer.putInt(AR_ALIGNMENT_OFFSET, mBuffer.getInt(AR_ALIGNMENT_OFFSET) + 1);
+    }
+
+    void push(int type, long timestamp, int floor, int code, double v0, double v1, double v2, double v3, double v4) {
+        if ((mBuffer.getInt(KEEP_LATEST_OFFSET) & (1 << type)) != 0) {
+            final int offset = LATEST_OFFSET + type * RECORD_SIZE;
+            final int sequence = mBuffer.getInt(offset);
+            mBuffer.putInt(offset, sequence + 1);
+            fence();
+            fill(offset, type, timestamp, floor, code, v0, v1, v2, v3, v4);
+            fence();
+            mBuffer.putInt(offset, sequence + 2);
+            return;
+        }
+
+        final int head = mBuffer.getInt(HEAD_OFFSET);
+        final int tail = mBuffer.getInt(TAIL_OFFSET);
+        fence();
+        if (head - tail >= RING_CAPACITY) {
+            addDropped(type);
+            return;
+        }
+        fill(RING_OFFSET + (head & (RING_CAPACITY - 1)) * RECORD_SIZE, type, timestamp, floor, code, v0, v1, v2, v3, v4);
+        fence();
+        mBuffer.putInt(HEAD_OFFSET, head + 1);
+    }
+}
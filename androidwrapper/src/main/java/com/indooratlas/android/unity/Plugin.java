@@ -2,6 +2,7 @@ package com.indooratlas.android.unity;
 
 import android.os.Bundle;
 import android.os.Handler;
+import android.os.SystemClock;
 import android.util.Log;
 import android.content.Context;
 
@@ -19,6 +20,7 @@ import com.indooratlas.android.sdk.IAOrientationRequest;
 import com.indooratlas.android.sdk.IALocationListener;
 import com.indooratlas.android.sdk.IAWayfindingListener;
 import com.indooratlas.android.sdk.IAARSession;
+import com.indooratlas.android.sdk.IAARObject;
 
 import com.indooratlas.android.sdk.resources.IAVenue;
 import com.indooratlas.android.sdk.resources.IAFloorPlan;
@@ -29,39 +31,126 @@ import org.json.JSONException;
 import org.json.JSONObject;
 
 import java.lang.String;
-import java.util.concurrent.FutureTask;
-import java.util.concurrent.ExecutionException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.FloatBuffer;
+import java.util.Arrays;
+import java.util.HashMap;
+import java.util.List;
 
 public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindingListener, IAOrientationListener {
     final static String TAG = "IndoorAtlasUnity";
-    final static float[] mNilMatrix = new float[]{};
-    private IALocationManager mLocationManager;
-    private IAARSession mARSession;
-    private double mDistanceFilter, mTimeFilter, mAttitudeFilter, mHeadingFilter;
-    private String mGameObject, mTraceId, mVersion;
+    // Bumped whenever methods called by LocationManager change, must match AndroidBridgeVersion in IndoorAtlasApi.cs
+    public final static int BRIDGE_VERSION = 5;
+    // Created on the main looper, nothing on the Unity thread ever waits for them.
+    // Work posted to mHandler runs in order, so posted runnables always see the location manager.
+    private volatile IALocationManager mLocationManager;
+    private volatile IAARSession mARSession;
+    private volatile boolean mArRequested;
+    private volatile double mDistanceFilter, mTimeFilter, mAttitudeFilter, mHeadingFilter;
+    private boolean mUpdating; // only touched on the main looper
+    private volatile String mGameObject, mVersion, mTraceId = "";
     private Handler mHandler;
-
-    private void wait(FutureTask task) {
-        try {
-            task.get();
-        } catch (InterruptedException | ExecutionException e) {
-            Log.e(TAG, e.toString());
-            throw new IllegalStateException(e.getMessage());
+    private final EventBuffer mEvents = new EventBuffer();
+    private volatile int mEventTransport = EventBuffer.TRANSPORT_JSON;
+    private final HashMap<String, String> mSentVenues = new HashMap<>();
+    // Venue objects whose hash is in mSentVenues, the SDK hands over the same object until the venue changes
+    private final HashMap<String, IAVenue> mSentVenueObjects = new HashMap<>();
+    private volatile IARegion mLastRegion; // latest entered region, serialized by benchmarkSerializer
+
+    // Per event type rate limit, samples arriving faster are coalesced so that only the latest one is delivered.
+    // Only touched on the main looper, where the SDK callbacks are delivered.
+    private final long[] mRateInterval = new long[EventBuffer.MAX_TYPES]; // milliseconds, 0 delivers every event
+    private final long[] mRateLast = new long[EventBuffer.MAX_TYPES];
+    private final boolean[] mRateScheduled = new boolean[EventBuffer.MAX_TYPES];
+    private final long[] mPendingTimestamp = new long[EventBuffer.MAX_TYPES];
+    private final int[] mPendingFloor = new int[EventBuffer.MAX_TYPES];
+    private final int[] mPendingCode = new int[EventBuffer.MAX_TYPES];
+    private final double[][] mPendingValues = new double[EventBuffer.MAX_TYPES][5];
+    private final Runnable[] mRateFlush = new Runnable[EventBuffer.MAX_TYPES];
+
+    // Filter changes while updating re-issue only the affected request, a burst of changes
+    // within FILTER_DEBOUNCE_MS costs a single re-registration
+    final static long FILTER_DEBOUNCE_MS = 100;
+    private final Runnable mReissueLocationRequest = new Runnable() {
+        @Override
+        public void run() {
+            if (!mUpdating) return;
+            mLocationManager.removeLocationUpdates(Plugin.this);
+            requestLocationUpdates();
         }
-    }
+    };
+    private final Runnable mReissueOrientationRequest = new Runnable() {
+        @Override
+        public void run() {
+            if (!mUpdating) return;
+            mLocationManager.unregisterOrientationListener(Plugin.this);
+            registerOrientationListener();
+        }
+    };
+
+    // AR frame layout, must be kept in sync with ArFrame in IndoorAtlasApi.cs:
+    // [converged, valid flags, turn count, valid turn count, compass[16], goal[16], valid turns[16 * n]]
+    final static int AR_FRAME_HEADER = 4;
+    final static int AR_FRAME_MATRIX = 16;
+    final static int AR_FRAME_MAX_TURNS = 64;
+    final static int AR_FRAME_VALID_COMPASS = 1 << 0;
+    final static int AR_FRAME_VALID_GOAL = 1 << 1;
+    private final ByteBuffer mArFrameBuffer = ByteBuffer.allocateDirect(
+            (AR_FRAME_HEADER + (2 + AR_FRAME_MAX_TURNS) * AR_FRAME_MATRIX) * 4).order(ByteOrder.nativeOrder());
+    private final FloatBuffer mArFrame = mArFrameBuffer.asFloatBuffer();
+    private final float[] mArMatrix = new float[16];
+
+    // Single matrix exchanged with the C# side through its direct address, see the *Buffer methods
+    private final ByteBuffer mArMatrixBuffer = ByteBuffer.allocateDirect(16 * 4).order(ByteOrder.nativeOrder());
+    private final FloatBuffer mArMatrixIo = mArMatrixBuffer.asFloatBuffer();
+    private final float[] mArMatrixIn = new float[16];
+
+    // Points and locations of arToGeoManyInBuffer, grown by getArToGeoBuffer.
+    // Each record holds the AR point as doubles x, y, z on input and the location on output:
+    // latitude, longitude, altitude (double), timestamp (long), accuracy, bearing (double), floor (int)
+    final static int AR_TO_GEO_RECORD = 56;
+    private ByteBuffer mArToGeoBuffer = ByteBuffer.allocateDirect(0).order(ByteOrder.nativeOrder());
+
+    // Planes of addArPlanesFromBuffer packed as (cx, cy, cz, ex, ez), grown by getArPlaneBuffer
+    final static int AR_PLANE_STRIDE = 5;
+    private ByteBuffer mArPlaneBuffer = ByteBuffer.allocateDirect(0).order(ByteOrder.nativeOrder());
+    private FloatBuffer mArPlanes = mArPlaneBuffer.asFloatBuffer();
+    private final float[] mArPlaneCenter = new float[3];
+    // Planes are only sent once, so the ones added before the session exists are kept until it does.
+    // Guarded by itself, grown only when more planes are pending than ever before.
+    private final float[] mPendingPlaneCenter = new float[3];
+    private float[] mPendingPlanes = new float[0];
+    private int mPendingPlaneCount;
+
+    // Coordinates and matrices of geoToArManyInBuffer, grown by getGeoToArBuffer.
+    // Each record holds latitude, longitude (double) and floor (int) on input and the 16 floats of the matrix on output
+    final static int GEO_TO_AR_RECORD = 16 * 4;
+    private ByteBuffer mGeoToArBuffer = ByteBuffer.allocateDirect(0).order(ByteOrder.nativeOrder());
+
+    // Geo to AR alignment tracking, a fixed reference point is converted whenever the AR pose is set
+    // and the alignment version in the event buffer header is bumped when its matrix changes.
+    // The probe is the first location received, everything else is only touched on the thread setting the pose.
+    private volatile IALocation mArProbe;
+    private boolean mArAligned;
+    private final float[] mArAlignment = new float[16];
+    private final float[] mArAlignmentProbe = new float[16];
 
     public void close() {
         releaseArSession();
-        FutureTask<Void> task = new FutureTask<>(new Runnable() {
+        final Handler handler = mHandler;
+        handler.post(new Runnable() {
             @Override
             public void run() {
+                // Coalesced events still waiting for their flush are never delivered
+                for (Runnable flush : mRateFlush) if (flush != null) handler.removeCallbacks(flush);
+                handler.removeCallbacks(mReissueLocationRequest);
+                handler.removeCallbacks(mReissueOrientationRequest);
                 mLocationManager.destroy();
+                mLocationManager = null;
+                mGameObject = null;
             }
-        }, null);
-        mHandler.post(task);
-        wait(task);
-        mLocationManager = null;
-        mGameObject = null;
+        });
         mHandler = null;
     }
 
@@ -75,15 +164,24 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
         extras.putString("com.indooratlas.android.sdk.intent.extras.wrapperVersion", "0.0.1");
         if (apiEndpoint.length() > 0) extras.putString("com.indooratlas.android.sdk.intent.extras.restEndpoint", apiEndpoint);
         mHandler = new Handler(((Context)context).getMainLooper());
-        FutureTask<Void> task = new FutureTask<>(new Runnable() {
+        mHandler.post(new Runnable() {
             @Override
             public void run() {
-                mLocationManager = IALocationManager.create((Context)context, extras);
-                mVersion = mLocationManager.getExtraInfo().version;
+                final IALocationManager manager = IALocationManager.create((Context)context, extras);
+                mVersion = manager.getExtraInfo().version;
+                mLocationManager = manager;
             }
-        }, null);
-        mHandler.post(task);
-        wait(task);
+        });
+    }
+
+    // True once the location manager has been created on the main looper
+    public boolean isReady() {
+        return mLocationManager != null;
+    }
+
+    // True once the AR session requested by the first AR call has been created
+    public boolean isArReady() {
+        return mARSession != null;
     }
 
     private JSONObject geofenceToJsonObject(IAGeofence iaGeofence) throws JSONException {
@@ -166,14 +264,38 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
         return 0;
     }
 
-    private String regionToJson(IARegion iaRegion) {
+    // 64-bit FNV-1a of the serialized venue, changes whenever any of its content does
+    private static String venueHash(String json) {
+        long hash = 0xcbf29ce484222325L;
+        for (int i = 0; i < json.length(); ++i) hash = (hash ^ json.charAt(i)) * 0x100000001b3L;
+        return String.format("%016x", hash);
+    }
+
+    private String regionToJson(IARegion iaRegion, HashMap<String, String> sentVenues, HashMap<String, IAVenue> sentVenueObjects) {
         try {
             JSONObject region = new JSONObject();
             region.put("id", iaRegion.getId());
             region.put("name", iaRegion.getName());
             region.put("timestamp", iaRegion.getTimestamp());
             region.put("type", regionTypeToInt(iaRegion.getType()));
-            region.put("venue", venueToJsonObject(iaRegion.getVenue()));
+            final IAVenue iaVenue = iaRegion.getVenue();
+            if (iaVenue != null) {
+                // The venue is only included the first time it (or a changed version of it) is sent,
+                // afterwards the region refers to it by venueId and venueHash and Unity uses its cached copy.
+                // It is only serialized and hashed again when the SDK hands over a different venue object.
+                final String id = iaVenue.getId();
+                region.put("venueId", id);
+                if (sentVenueObjects.get(id) != iaVenue) {
+                    final JSONObject venue = venueToJsonObject(iaVenue);
+                    final String hash = venueHash(venue.toString());
+                    if (!hash.equals(sentVenues.get(id))) {
+                        region.put("venue", venue);
+                        sentVenues.put(id, hash);
+                    }
+                    sentVenueObjects.put(id, iaVenue);
+                }
+                region.put("venueHash", sentVenues.get(id));
+            }
             region.put("floorplan", floorplanToJsonObject(iaRegion.getFloorPlan()));
             region.put("geofence", new JSONObject());
             return region.toString();
@@ -183,68 +305,153 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
         }
     }
 
-    private String locationToJson(IALocation iaLocation) {
-        if (iaLocation == null) return "";
+    private static String eventCallback(int type) {
+        switch (type) {
+            case EventBuffer.TYPE_LOCATION: return "NativeIndoorAtlasOnLocationChanged";
+            case EventBuffer.TYPE_HEADING: return "NativeIndoorAtlasOnHeadingChanged";
+            case EventBuffer.TYPE_ORIENTATION: return "NativeIndoorAtlasOnOrientationChanged";
+            case EventBuffer.TYPE_STATUS: return "NativeIndoorAtlasOnStatusChanged";
+        }
+        return null;
+    }
+
+    private static String eventToJson(int type, long timestamp, int floor, int code, double v0, double v1, double v2, double v3, double v4) {
         try {
-            JSONObject location = new JSONObject(), position = new JSONObject(), coordinate = new JSONObject();
-            location.put("accuracy", iaLocation.getAccuracy());
-            location.put("altitude", iaLocation.getAltitude());
-            location.put("bearing", iaLocation.getBearing());
-            coordinate.put("latitude", iaLocation.getLatitude());
-            coordinate.put("longitude", iaLocation.getLongitude());
-            position.put("coordinate", coordinate);
-            position.put("floor", iaLocation.getFloorLevel());
-            location.put("position", position);
-            location.put("timestamp", iaLocation.getTime());
-            return location.toString();
+            JSONObject event = new JSONObject();
+            switch (type) {
+                case EventBuffer.TYPE_LOCATION:
+                    JSONObject position = new JSONObject(), coordinate = new JSONObject();
+                    event.put("accuracy", v2);
+                    event.put("altitude", v3);
+                    event.put("bearing", v4);
+                    coordinate.put("latitude", v0);
+                    coordinate.put("longitude", v1);
+                    position.put("coordinate", coordinate);
+                    position.put("floor", floor);
+                    event.put("position", position);
+                    event.put("timestamp", timestamp);
+                    break;
+                case EventBuffer.TYPE_HEADING:
+                    event.put("timestamp", timestamp);
+                    event.put("heading", v0);
+                    break;
+                case EventBuffer.TYPE_ORIENTATION:
+                    event.put("x", v0);
+                    event.put("y", v1);
+                    event.put("z", v2);
+                    event.put("w", v3);
+                    event.put("timestamp", timestamp);
+                    break;
+                case EventBuffer.TYPE_STATUS:
+                    event.put("status", code);
+                    break;
+            }
+            return event.toString();
         } catch (JSONException e) {
             Log.e(TAG, e.toString());
             throw new IllegalStateException(e.getMessage());
         }
     }
 
+    private void sendEvent(int type, long timestamp, int floor, int code, double v0, double v1, double v2, double v3, double v4) {
+        if (mEventTransport == EventBuffer.TRANSPORT_BINARY) {
+            mEvents.push(type, timestamp, floor, code, v0, v1, v2, v3, v4);
+            return;
+        }
+        UnityPlayer.UnitySendMessage(mGameObject, eventCallback(type), eventToJson(type, timestamp, floor, code, v0, v1, v2, v3, v4));
+    }
+
+    private void flushEvent(int type) {
+        if (!mRateScheduled[type]) return;
+        mRateScheduled[type] = false;
+        mRateLast[type] = SystemClock.uptimeMillis();
+        final double[] v = mPendingValues[type];
+        sendEvent(type, mPendingTimestamp[type], mPendingFloor[type], mPendingCode[type], v[0], v[1], v[2], v[3], v[4]);
+    }
+
+    private void deliverEvent(final int type, long timestamp, int floor, int code, double v0, double v1, double v2, double v3, double v4) {
+        if (mRateInterval[type] > 0) {
+            final long now = SystemClock.uptimeMillis();
+            if (now - mRateLast[type] < mRateInterval[type]) {
+                // Replacing a sample that was never delivered counts as a drop, same as a full ring
+                final boolean replaced = mRateScheduled[type];
+                if (replaced) mEvents.addDropped(type);
+                final double[] v = mPendingValues[type];
+                mPendingTimestamp[type] = timestamp;
+                mPendingFloor[type] = floor;
+                mPendingCode[type] = code;
+                v[0] = v0; v[1] = v1; v[2] = v2; v[3] = v3; v[4] = v4;
+                if (!replaced) {
+                    mRateScheduled[type] = true;
+                    if (mRateFlush[type] == null) {
+                        mRateFlush[type] = new Runnable() {
+                            @Override
+                            public void run() {
+                                flushEvent(type);
+                            }
+                        };
+                    }
+                    mHandler.postAtTime(mRateFlush[type], mRateLast[type] + mRateInterval[type]);
+                }
+                return;
+            }
+            mRateLast[type] = now;
+        }
+        if (mRateScheduled[type]) {
+            // The flush is due but has not run yet, this newer sample replaces the pending one
+            // instead of being delivered before it
+            mRateScheduled[type] = false;
+            mHandler.removeCallbacks(mRateFlush[type]);
+            mEvents.addDropped(type);
+        }
+        sendEvent(type, timestamp, floor, code, v0, v1, v2, v3, v4);
+    }
+
+    // Android has no extra info callback, so the trace ID is checked whenever the positioning session may have changed.
+    // Unity keeps the latest extra info cached, so it is only sent when it changes.
+    private void updateExtraInfo() {
+        final String traceId = mLocationManager.getExtraInfo().traceId;
+        if (traceId == null || traceId.equals(mTraceId)) return;
+        mTraceId = traceId;
+        try {
+            JSONObject extraInfo = new JSONObject();
+            extraInfo.put("traceId", traceId);
+            UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnExtraInfo", extraInfo.toString());
+        } catch(JSONException e) {
+            Log.e(TAG, e.toString());
+            throw new IllegalStateException(e.getMessage());
+        }
+    }
+
     @Override
     public void onEnterRegion(IARegion iaRegion) {
-        UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnEnterRegion", regionToJson(iaRegion));
+        mLastRegion = iaRegion;
+        updateExtraInfo();
+        UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnEnterRegion", regionToJson(iaRegion, mSentVenues, mSentVenueObjects));
     }
 
     @Override
     public void onExitRegion(IARegion iaRegion) {
-        UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnExitRegion", regionToJson(iaRegion));
+        UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnExitRegion", regionToJson(iaRegion, mSentVenues, mSentVenueObjects));
     }
 
     @Override
     public void onHeadingChanged(long timestamp, double heading) {
-        try {
-            JSONObject headingObject = new JSONObject();
-            headingObject.put("timestamp", timestamp);
-            headingObject.put("heading", heading);
-            UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnHeadingChanged", headingObject.toString());
-        } catch(JSONException e) {
-            Log.e(TAG, e.toString());
-            throw new IllegalStateException(e.getMessage());
-        }
+        deliverEvent(EventBuffer.TYPE_HEADING, timestamp, 0, 0, heading, 0, 0, 0, 0);
     }
 
     @Override
     public void onOrientationChange(long timestamp, double[] quaternion) {
-        try {
-            JSONObject orientation = new JSONObject();
-            orientation.put("x", quaternion[1]);
-            orientation.put("y", quaternion[2]);
-            orientation.put("z", quaternion[3]);
-            orientation.put("w", quaternion[0]);
-            orientation.put("timestamp", timestamp);
-            UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnOrientationChanged", orientation.toString());
-        } catch(JSONException e) {
-            Log.e(TAG, e.toString());
-            throw new IllegalStateException(e.getMessage());
-        }
+        deliverEvent(EventBuffer.TYPE_ORIENTATION, timestamp, 0, 0, quaternion[1], quaternion[2], quaternion[3], quaternion[0], 0);
     }
 
     @Override
     public void onLocationChanged(IALocation iaLocation) {
-        UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnLocationChanged", locationToJson(iaLocation));
+        if (iaLocation == null) return;
+        if (mArProbe == null) mArProbe = iaLocation;
+        deliverEvent(EventBuffer.TYPE_LOCATION, iaLocation.getTime(), iaLocation.getFloorLevel(), 0,
+                iaLocation.getLatitude(), iaLocation.getLongitude(), iaLocation.getAccuracy(),
+                iaLocation.getAltitude(), iaLocation.getBearing());
     }
 
     @Override
@@ -266,14 +473,8 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
             default:
                 return;
         }
-        try {
-            JSONObject statusObject = new JSONObject();
-            statusObject.put("status", outputStatus);
-            UnityPlayer.UnitySendMessage(mGameObject, "NativeIndoorAtlasOnStatusChanged", statusObject.toString());
-        } catch(JSONException e) {
-            Log.e(TAG, e.toString());
-            throw new IllegalStateException(e.getMessage());
-        }
+        updateExtraInfo();
+        deliverEvent(EventBuffer.TYPE_STATUS, System.currentTimeMillis(), 0, outputStatus, 0, 0, 0, 0, 0);
     }
 
     private static JSONObject jsonObjectFromRoutingLeg(IARoute.Leg routingLeg) {
@@ -323,11 +524,65 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
     }
 
     public String versionString() {
-        return mVersion;
+        final String version = mVersion;
+        return (version != null ? version : "");
+    }
+
+    public void setEventTransport(int transport) {
+        mEventTransport = transport;
+    }
+
+    public void setEventRateLimit(final int type, final double interval) {
+        if (type <= 0 || type >= EventBuffer.MAX_TYPES) return;
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                mRateInterval[type] = (long)(Math.max(interval, 0) * 1000.0);
+            }
+        });
+    }
+
+    private void reissueRequest(Runnable reissue) {
+        if (mHandler == null) return;
+        mHandler.removeCallbacks(reissue);
+        mHandler.postDelayed(reissue, FILTER_DEBOUNCE_MS);
+    }
+
+    // Serializers measured by benchmarkSerializer, same values as LocationManager.Serializer
+    final static int SERIALIZER_LOCATION = 0; // location event for the JSON transport
+    final static int SERIALIZER_REGION_VENUE = 1; // latest entered region including its venue
+    final static int SERIALIZER_REGION = 2; // latest entered region referring to its already sent venue
+
+    // Runs the serializer iterations times and returns the duration of each run in microseconds,
+    // empty if there is nothing to serialize (no region entered yet)
+    public double[] benchmarkSerializer(int serializer, int iterations) {
+        final IARegion region = mLastRegion;
+        if (serializer != SERIALIZER_LOCATION && region == null) return new double[0];
+        final HashMap<String, String> sentVenues = new HashMap<>();
+        final HashMap<String, IAVenue> sentVenueObjects = new HashMap<>();
+        if (region != null) regionToJson(region, sentVenues, sentVenueObjects); // the venue is sent by the first call only
+        final double[] microseconds = new double[iterations];
+        for (int i = 0; i < iterations; ++i) {
+            if (serializer == SERIALIZER_REGION_VENUE) {
+                sentVenues.clear();
+                sentVenueObjects.clear();
+            }
+            final long start = System.nanoTime();
+            if (serializer == SERIALIZER_LOCATION) eventToJson(EventBuffer.TYPE_LOCATION, 1700000000000L, 2, 0, 60.1699, 24.9384, 3.5, 12.0, 90.0);
+            else regionToJson(region, sentVenues, sentVenueObjects);
+            microseconds[i] = (System.nanoTime() - start) / 1000.0;
+        }
+        return microseconds;
+    }
+
+    public ByteBuffer getEventBuffer() {
+        return mEvents.getBuffer();
     }
 
     public void setDistanceFilter(double filter) {
+        if (filter == mDistanceFilter) return;
         mDistanceFilter = filter;
+        reissueRequest(mReissueLocationRequest);
     }
 
     public double getDistanceFilter() {
@@ -335,7 +590,9 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
     }
 
     public void setTimeFilter(double filter) {
+        if (filter == mTimeFilter) return;
         mTimeFilter = filter;
+        reissueRequest(mReissueLocationRequest);
     }
 
     public double getTimeFilter() {
@@ -343,7 +600,9 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
     }
 
     public void setHeadingFilter(double filter) {
+        if (filter == mHeadingFilter) return;
         mHeadingFilter = filter;
+        reissueRequest(mReissueOrientationRequest);
     }
 
     public double getHeadingFilter() {
@@ -351,7 +610,9 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
     }
 
     public void setAttitudeFilter(double filter) {
+        if (filter == mAttitudeFilter) return;
         mAttitudeFilter = filter;
+        reissueRequest(mReissueOrientationRequest);
     }
 
     public double getAttitudeFilter() {
@@ -388,18 +649,26 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
         mHandler.post(r);
     }
 
+    private void requestLocationUpdates() {
+        IALocationRequest request = IALocationRequest.create();
+        request.setFastestInterval((long)(mTimeFilter * 1000.0));
+        request.setSmallestDisplacement((float)mDistanceFilter);
+        mLocationManager.requestLocationUpdates(request, this);
+    }
+
+    private void registerOrientationListener() {
+        mLocationManager.registerOrientationListener(new IAOrientationRequest(mHeadingFilter, mAttitudeFilter), this);
+    }
+
     public void startUpdatingLocation() {
         final Runnable r = new Runnable() {
             @Override
             public void run() {
                 mLocationManager.registerRegionListener(Plugin.this);
-                // TODO: we should re-request location updates if mTimeFilter or mDistanceFilter changes
-                IALocationRequest request = IALocationRequest.create();
-                request.setFastestInterval((long)(mTimeFilter * 1000.0));
-                request.setSmallestDisplacement((float)mDistanceFilter);
-                mLocationManager.requestLocationUpdates(request, Plugin.this);
-                // TODO: we should re-register orientation listener if mHeadingFilter or mAttitudeFilter changes
-                mLocationManager.registerOrientationListener(new IAOrientationRequest(mHeadingFilter, mAttitudeFilter), Plugin.this);
+                requestLocationUpdates();
+                registerOrientationListener();
+                mUpdating = true;
+                updateExtraInfo();
             }
         };
         mHandler.post(r);
@@ -409,6 +678,9 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
         final Runnable r = new Runnable() {
             @Override
             public void run() {
+                mUpdating = false;
+                mHandler.removeCallbacks(mReissueLocationRequest);
+                mHandler.removeCallbacks(mReissueOrientationRequest);
                 mLocationManager.unregisterRegionListener(Plugin.this);
                 mLocationManager.removeLocationUpdates(Plugin.this);
                 mLocationManager.unregisterOrientationListener(Plugin.this);
@@ -454,79 +726,268 @@ public class Plugin implements IARegion.Listener, IALocationListener, IAWayfindi
         mHandler.post(r);
     }
 
+    // Snapshot updated on the main looper, see updateExtraInfo
     public String getTraceId() {
-        // Potentially not thread safe, but very slow with thread dispatch :(
-        return mLocationManager.getExtraInfo().traceId;
+        return mTraceId;
     }
 
+    // Returns the AR session, or null until it has been created on the main looper.
+    // AR calls made before that return their defaults instead of blocking the Unity thread.
     private IAARSession getArSession() {
-        if (mARSession == null) {
-            FutureTask<Void> task = new FutureTask<>(new Runnable() {
+        final IAARSession session = mARSession;
+        if (session == null && !mArRequested) {
+            mArRequested = true;
+            mHandler.post(new Runnable() {
                 @Override
                 public void run() {
+                    if (!mArRequested || mARSession != null) return;
                     mARSession = mLocationManager.requestArUpdates();
+                    addPendingArPlanes(mARSession);
                 }
-            }, null);
-            mHandler.post(task);
-            wait(task);
+            });
         }
-        return mARSession;
+        return session;
     }
 
     public void releaseArSession() {
-        if (mARSession != null) {
-            mARSession.destroy();
+        mArRequested = false;
+        mArProbe = null;
+        if (mArAligned) mEvents.addArAlignment();
+        mArAligned = false;
+        synchronized (mPendingPlaneCenter) {
+            mPendingPlaneCount = 0;
+        }
+        final IAARSession session = mARSession;
+        if (session != null) {
+            session.destroy();
             mARSession = null;
+        } else if (mHandler != null) {
+            // A session still being created is destroyed once it exists
+            mHandler.post(new Runnable() {
+                @Override
+                public void run() {
+                    if (mArRequested || mARSession == null) return;
+                    mARSession.destroy();
+                    mARSession = null;
+                }
+            });
         }
     }
 
     public void setArPoseMatrix(float[] matrix) {
-        getArSession().setPoseMatrix(matrix);
+        final IAARSession session = getArSession();
+        if (session == null) return;
+        session.setPoseMatrix(matrix);
+        updateArAlignment(session);
+    }
+
+    // The probe never moves, so any change of its AR matrix is a change of the alignment
+    private void updateArAlignment(IAARSession session) {
+        final IALocation probe = mArProbe;
+        final boolean aligned = probe != null && session.converged() &&
+                session.geoToAr(probe.getLatitude(), probe.getLongitude(), probe.getFloorLevel(), mArAlignmentProbe);
+        if (aligned == mArAligned && (!aligned || Arrays.equals(mArAlignmentProbe, mArAlignment))) return;
+        mArAligned = aligned;
+        System.arraycopy(mArAlignmentProbe, 0, mArAlignment, 0, 16);
+        mEvents.addArAlignment();
     }
 
     public void setArCameraToWorldMatrix(float[] matrix) {
-        getArSession().setCameraToWorldMatrix(matrix);
+        final IAARSession session = getArSession();
+        if (session != null) session.setCameraToWorldMatrix(matrix);
     }
 
     public boolean getArIsConverged() {
-        return getArSession().converged();
+        final IAARSession session = getArSession();
+        return session != null && session.converged();
     }
 
-    public float[] getArCompassMatrix() {
-        float[] matrix = new float[16];
-        if (getArSession().getWayfindingCompassArrow().updateModelMatrix(matrix)) return matrix;
-        return mNilMatrix;
+    public ByteBuffer getArMatrixBuffer() {
+        return mArMatrixBuffer;
     }
 
-    public float[] getArGoalMatrix() {
-        float[] matrix = new float[16];
-        if (getArSession().getWayfindingTarget().updateModelMatrix(matrix)) return matrix;
-        return mNilMatrix;
+    private float[] readArMatrixBuffer() {
+        for (int i = 0; i < 16; ++i) mArMatrixIn[i] = mArMatrixIo.get(i);
+        return mArMatrixIn;
+    }
+
+    // Copies mArMatrix to the matrix buffer if valid
+    private boolean writeArMatrixBuffer(boolean valid) {
+        if (valid) for (int i = 0; i < 16; ++i) mArMatrixIo.put(i, mArMatrix[i]);
+        return valid;
+    }
+
+    public void setArPoseMatrixFromBuffer() {
+        setArPoseMatrix(readArMatrixBuffer());
+    }
+
+    public void setArCameraToWorldMatrixFromBuffer() {
+        setArCameraToWorldMatrix(readArMatrixBuffer());
+    }
+
+    public boolean getArCompassMatrixToBuffer() {
+        final IAARSession session = getArSession();
+        return writeArMatrixBuffer(session != null && session.getWayfindingCompassArrow().updateModelMatrix(mArMatrix));
+    }
+
+    public boolean getArGoalMatrixToBuffer() {
+        final IAARSession session = getArSession();
+        return writeArMatrixBuffer(session != null && session.getWayfindingTarget().updateModelMatrix(mArMatrix));
+    }
+
+    public boolean getArTurnMatrixToBuffer(int index) {
+        final IAARSession session = getArSession();
+        return writeArMatrixBuffer(session != null && session.getWayfindingTurnArrows().get(index).updateModelMatrix(mArMatrix));
+    }
+
+    public boolean geoToArToBuffer(double lat, double lon, int floor, float heading, float zOffset) {
+        final IAARSession session = getArSession();
+        return writeArMatrixBuffer(session != null && session.geoToAr(lat, lon, floor, heading, zOffset, mArMatrix));
     }
 
     public int getArTurnCount() {
-        return getArSession().getWayfindingTurnArrows().size();
+        final IAARSession session = getArSession();
+        return (session != null ? session.getWayfindingTurnArrows().size() : 0);
+    }
+
+    public ByteBuffer getArFrameBuffer() {
+        return mArFrameBuffer;
     }
 
-    public float[] getArTurnMatrix(int index) {
-        float[] matrix = new float[16];
-        if (getArSession().getWayfindingTurnArrows().get(index).updateModelMatrix(matrix)) return matrix;
-        return mNilMatrix;
+    private void putArFrameMatrix(int index) {
+        final int offset = AR_FRAME_HEADER + index * AR_FRAME_MATRIX;
+        for (int i = 0; i < 16; ++i) mArFrame.put(offset + i, mArMatrix[i]);
+    }
+
+    // Fills the AR frame buffer and returns number of floats written
+    public int getArFrame() {
+        final IAARSession session = getArSession();
+        for (int i = 0; i < AR_FRAME_HEADER; ++i) mArFrame.put(i, 0);
+        if (session == null || !session.converged()) return AR_FRAME_HEADER;
+
+        int flags = 0, valid = 0;
+        if (session.getWayfindingCompassArrow().updateModelMatrix(mArMatrix)) {
+            flags |= AR_FRAME_VALID_COMPASS;
+            putArFrameMatrix(0);
+        }
+        if (session.getWayfindingTarget().updateModelMatrix(mArMatrix)) {
+            flags |= AR_FRAME_VALID_GOAL;
+            putArFrameMatrix(1);
+        }
+        final List<IAARObject> turns = session.getWayfindingTurnArrows();
+        for (int i = 0; i < turns.size() && valid < AR_FRAME_MAX_TURNS; ++i) {
+            if (!turns.get(i).updateModelMatrix(mArMatrix)) continue;
+            putArFrameMatrix(2 + valid);
+            ++valid;
+        }
+
+        mArFrame.put(0, 1);
+        mArFrame.put(1, flags);
+        mArFrame.put(2, turns.size());
+        mArFrame.put(3, valid);
+        return AR_FRAME_HEADER + (2 + valid) * AR_FRAME_MATRIX;
     }
 
-    public void addArPlane(float cx, float cy, float cz, float ex, float ez) {
-        getArSession().addArPlane(new float[]{cx, cy, cz}, ex, ez);
+    public ByteBuffer getArPlaneBuffer(int capacity) {
+        if (mArPlaneBuffer.capacity() < capacity * AR_PLANE_STRIDE * 4) {
+            mArPlaneBuffer = ByteBuffer.allocateDirect(capacity * AR_PLANE_STRIDE * 4).order(ByteOrder.nativeOrder());
+            mArPlanes = mArPlaneBuffer.asFloatBuffer();
+        }
+        return mArPlaneBuffer;
+    }
+
+    // Adds the first count planes of the AR plane buffer
+    public void addArPlanesFromBuffer(int count) {
+        final IAARSession session = getArSession();
+        if (session != null) {
+            for (int i = 0; i < count; ++i) {
+                final int o = i * AR_PLANE_STRIDE;
+                mArPlaneCenter[0] = mArPlanes.get(o);
+                mArPlaneCenter[1] = mArPlanes.get(o + 1);
+                mArPlaneCenter[2] = mArPlanes.get(o + 2);
+                session.addArPlane(mArPlaneCenter, mArPlanes.get(o + 3), mArPlanes.get(o + 4));
+            }
+            return;
+        }
+        synchronized (mPendingPlaneCenter) {
+            final int size = (mPendingPlaneCount + count) * AR_PLANE_STRIDE;
+            if (mPendingPlanes.length < size) mPendingPlanes = Arrays.copyOf(mPendingPlanes, Math.max(size, 2 * mPendingPlanes.length));
+            for (int i = 0; i < count * AR_PLANE_STRIDE; ++i) mPendingPlanes[mPendingPlaneCount * AR_PLANE_STRIDE + i] = mArPlanes.get(i);
+            mPendingPlaneCount += count;
+        }
+        // the session may have been created after it was checked above
+        if (mARSession != null) addPendingArPlanes(mARSession);
+    }
+
+    private void addPendingArPlanes(IAARSession session) {
+        synchronized (mPendingPlaneCenter) {
+            for (int i = 0; i < mPendingPlaneCount; ++i) {
+                final int o = i * AR_PLANE_STRIDE;
+                mPendingPlaneCenter[0] = mPendingPlanes[o];
+                mPendingPlaneCenter[1] = mPendingPlanes[o + 1];
+                mPendingPlaneCenter[2] = mPendingPlanes[o + 2];
+                session.addArPlane(mPendingPlaneCenter, mPendingPlanes[o + 3], mPendingPlanes[o + 4]);
+            }
+            mPendingPlaneCount = 0;
+        }
     }
 
-    public float[] geoToAr(double lat, double lon, int floor, float heading, float zOffset) {
-        float[] matrix = new float[16];
-        if (getArSession().geoToAr(lat, lon, floor, heading, zOffset, matrix)) return matrix;
-        return mNilMatrix;
+    public ByteBuffer getGeoToArBuffer(int capacity) {
+        if (mGeoToArBuffer.capacity() < capacity * GEO_TO_AR_RECORD) {
+            mGeoToArBuffer = ByteBuffer.allocateDirect(capacity * GEO_TO_AR_RECORD).order(ByteOrder.nativeOrder());
+        }
+        return mGeoToArBuffer;
+    }
+
+    // Converts the first count coordinates of the geo to AR buffer in place and returns the number converted,
+    // records of coordinates that could not be converted are set to identity
+    public int geoToArManyInBuffer(int count, float heading, float zOffset) {
+        final IAARSession session = getArSession();
+        final ByteBuffer b = mGeoToArBuffer;
+        int converted = 0;
+        for (int i = 0; i < count; ++i) {
+            final int o = i * GEO_TO_AR_RECORD;
+            if (session != null && session.geoToAr(b.getDouble(o), b.getDouble(o + 8), b.getInt(o + 16), heading, zOffset, mArMatrix)) {
+                for (int j = 0; j < 16; ++j) b.putFloat(o + j * 4, mArMatrix[j]);
+                ++converted;
+            } else {
+                for (int j = 0; j < 16; ++j) b.putFloat(o + j * 4, (j % 5 == 0 ? 1 : 0));
+            }
+        }
+        return converted;
     }
 
-    public String arToGeo(float x, float y, float z) {
-        IALocation loc = getArSession().arToGeo(x, y, z);
-        return locationToJson(loc);
+    public ByteBuffer getArToGeoBuffer(int capacity) {
+        if (mArToGeoBuffer.capacity() < capacity * AR_TO_GEO_RECORD) {
+            mArToGeoBuffer = ByteBuffer.allocateDirect(capacity * AR_TO_GEO_RECORD).order(ByteOrder.nativeOrder());
+        }
+        return mArToGeoBuffer;
+    }
+
+    // Converts the first count points of the AR to geo buffer in place and returns the number converted,
+    // records of points that could not be converted are zeroed
+    public int arToGeoManyInBuffer(int count) {
+        final IAARSession session = getArSession();
+        final ByteBuffer b = mArToGeoBuffer;
+        int converted = 0;
+        for (int i = 0; i < count; ++i) {
+            final int o = i * AR_TO_GEO_RECORD;
+            final IALocation l = (session != null ?
+                    session.arToGeo((float)b.getDouble(o), (float)b.getDouble(o + 8), (float)b.getDouble(o + 16)) : null);
+            if (l == null) {
+                for (int j = 0; j < AR_TO_GEO_RECORD; j += 8) b.putLong(o + j, 0);
+                continue;
+            }
+            b.putDouble(o, l.getLatitude());
+            b.putDouble(o + 8, l.getLongitude());
+            b.putDouble(o + 16, l.getAltitude());
+            b.putLong(o + 24, l.getTime());
+            b.putDouble(o + 32, l.getAccuracy());
+            b.putDouble(o + 40, l.getBearing());
+            b.putInt(o + 48, l.getFloorLevel());
+            ++converted;
+        }
+        return converted;
     }
 
     public void setLocation(String loc) {